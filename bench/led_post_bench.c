@@ -0,0 +1,55 @@
+// Host benchmark for the per-frame post-processing in main/led_post.c
+//
+//   gcc -O2 -Imain bench/led_post_bench.c main/led_post.c -lm -o led_post_bench
+//   ./led_post_bench
+
+#include "led_post.h"
+#include <stdio.h>
+#include <time.h>
+
+#define PIXEL_COUNT 75
+#define FRAMES 1000000
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(const char *name, uint32_t color, uint32_t budget_ma)
+{
+    uint32_t in[PIXEL_COUNT];
+    uint32_t out[PIXEL_COUNT];
+    for (int i = 0; i < PIXEL_COUNT; i++)
+    {
+        in[i] = color;
+    }
+
+    led_post_set_budget(budget_ma);
+    volatile uint32_t ma = 0;
+    double start = now_seconds();
+    for (int i = 0; i < FRAMES; i++)
+    {
+        in[i % PIXEL_COUNT] ^= 1; // Keep the compiler from hoisting the work
+        ma = led_post_apply(in, out, PIXEL_COUNT);
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("%-28s %8.1f ns/frame  %5u mA\n", name, elapsed * 1e9 / FRAMES, (unsigned)ma);
+}
+
+int main(void)
+{
+    led_post_init(2.2f);
+
+    bench("white, unlimited", 0x787878, 0);
+    bench("white, 1500mA budget", 0x787878, 1500);
+    bench("full white, 1500mA budget", 0xFFFFFF, 1500);
+    bench("full white, 500mA budget", 0xFFFFFF, 500);
+
+    led_post_set_brightness(48);
+    bench("full white, night brightness", 0xFFFFFF, 1500);
+
+    return 0;
+}
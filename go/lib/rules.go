@@ -0,0 +1,56 @@
+package lib
+
+import (
+	"encoding/json"
+	"fmt"
+	"os"
+)
+
+// Limits of the controller firmware, see EFFECT_RULES_MAX and EFFECT_RULES_MAX_MESSAGE in effect_rules.h
+const (
+	MaxEffectRules        = 16
+	MaxEffectRulesMessage = 4096
+)
+
+// EffectRules is the versioned effect rule set pushed to the lights controller.
+// The controller reports its version in a hello message and stores newer sets in NVS.
+type EffectRules struct {
+	Type    string          `json:"type"`
+	Version uint32          `json:"version"`
+	Rules   json.RawMessage `json:"rules"`
+}
+
+type Hello struct {
+	Type         string `json:"type"`
+	RulesVersion uint32 `json:"rules_version"`
+}
+
+func LoadEffectRules(path string) (*EffectRules, error) {
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+
+	rules := &EffectRules{}
+	if err := json.Unmarshal(data, rules); err != nil {
+		return nil, err
+	}
+	rules.Type = "rules"
+
+	// The controller drops sets it cannot hold, so it would never reach this version
+	var list []json.RawMessage
+	if err := json.Unmarshal(rules.Rules, &list); err != nil {
+		return nil, err
+	}
+	if len(list) > MaxEffectRules {
+		return nil, fmt.Errorf("%d effect rules, the controller holds at most %d", len(list), MaxEffectRules)
+	}
+	message, err := json.Marshal(rules)
+	if err != nil {
+		return nil, err
+	}
+	if len(message) > MaxEffectRulesMessage {
+		return nil, fmt.Errorf("effect rules message is %d bytes, the controller accepts at most %d", len(message), MaxEffectRulesMessage)
+	}
+	return rules, nil
+}
@@ -22,6 +22,7 @@ type MessageClient interface {
 
 type Hub struct {
 	Clients map[context.Context]MessageClient
+	Rules   *EffectRules
 }
 
 func (h *Hub) AddClient(ctx context.Context, client MessageClient) {
@@ -39,6 +40,23 @@ func (h *Hub) Broadcast(msg Message) {
 	}
 }
 
+// Push our effect rules to a client that reports a different version
+func (h *Hub) HandleClientMessage(ctx context.Context, client MessageClient, msg []byte) {
+	var hello Hello
+	if err := json.Unmarshal(msg, &hello); err != nil || hello.Type != "hello" {
+		return
+	}
+
+	log.Printf("Client has effect rules version %d", hello.RulesVersion)
+	if h.Rules == nil || h.Rules.Version == hello.RulesVersion {
+		return
+	}
+
+	json, _ := json.Marshal(h.Rules)
+	log.Printf("Sending effect rules version %d", h.Rules.Version)
+	client.Write(ctx, websocket.MessageText, json)
+}
+
 func StartWebsocketServer(hub *Hub) {
 
 	fn := http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
@@ -66,8 +84,20 @@ func StartWebsocketServer(hub *Hub) {
 		ctx, cancel := context.WithCancel(context.Background())
 		defer cancel()
 
-		ctx = c.CloseRead(ctx)
 		hub.AddClient(ctx, c)
+
+		// Read client messages until the connection is closed
+		go func() {
+			defer cancel()
+			for {
+				_, msg, err := c.Read(ctx)
+				if err != nil {
+					return
+				}
+				hub.HandleClientMessage(ctx, c, msg)
+			}
+		}()
+
 		// Wait until the connection is closed
 		<-ctx.Done()
 		log.Println("Client disconnected")
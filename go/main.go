@@ -3,6 +3,7 @@ package main
 import (
 	"context"
 	"log"
+	"os"
 	"time"
 
 	"github.com/joho/godotenv"
@@ -20,6 +21,16 @@ func main() {
 		Clients: make(map[context.Context]lib.MessageClient),
 	}
 
+	// Optional effect rules pushed to the lights controller
+	if path := os.Getenv("RULES_FILE"); path != "" {
+		rules, err := lib.LoadEffectRules(path)
+		if err != nil {
+			log.Printf("Failed to load effect rules: %v", err)
+		} else {
+			hub.Rules = rules
+		}
+	}
+
 	// Broadcast messages to all clients
 	go func() {
 		for msg := range Broadcast {
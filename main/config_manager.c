@@ -1,124 +1,94 @@
 #include "config_manager.h"
+#include "config_portal.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_wifi.h"
 #include "esp_netif.h"
 #include "esp_event.h"
-#include "esp_http_server.h"
 #include "esp_system.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
-#include <sys/param.h>
-
-static inline int min(int a, int b) { return a < b ? a : b; }
 
 static const char *TAG = "CONFIG_MANAGER";
 static const char *CONFIG_NAMESPACE = "device_config";
-static const char *CONFIG_KEY = "config_data";
-
-static httpd_handle_t server = NULL;
-static device_config_t current_config;
-
-static const char *HTML_FORM = 
-    "<!DOCTYPE html><html><head><title>BITAXE LED Configuration</title>"
-    "<style>body{font-family:Arial,sans-serif;max-width:600px;margin:0 auto;padding:20px}"
-    "input{width:100%;padding:8px;margin:5px 0;border:1px solid #ddd;border-radius:4px}"
-    "button{background:#4CAF50;color:white;padding:10px 15px;border:none;border-radius:4px;cursor:pointer}"
-    "</style></head><body>"
-    "<h2>BITAXE LED Configuration</h2>"
-    "<form action='/save' method='post'>"
-    "<label>WiFi SSID:</label><br>"
-    "<input type='text' name='ssid' required><br>"
-    "<label>WiFi Password:</label><br>"
-    "<input type='password' name='password' required><br>"
-    "<label>WebSocket Server:</label><br>"
-    "<input type='text' name='websocket' required><br>"
-    "<button type='submit'>Save Configuration</button>"
-    "</form></body></html>";
-
-static esp_err_t root_get_handler(httpd_req_t *req)
-{
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, HTML_FORM, strlen(HTML_FORM));
-    return ESP_OK;
-}
-
-static esp_err_t save_post_handler(httpd_req_t *req)
-{
-    // Check if request is too large
-    if (req->content_len > 1024) {
-        ESP_LOGE(TAG, "Request too large: %d bytes", req->content_len);
-        httpd_resp_send_err(req, HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE, "Request too large");
-        return ESP_FAIL;
-    }
-
-    char buf[2048];
-    int ret, remaining = req->content_len;
-
-    while (remaining > 0) {
-        if ((ret = httpd_req_recv(req, buf, min(remaining, sizeof(buf)))) <= 0) {
-            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-                continue;
-            }
-            ESP_LOGE(TAG, "Error receiving request data");
-            return ESP_FAIL;
-        }
-        remaining -= ret;
-    }
-    buf[req->content_len] = '\0';
-
-    // Parse form data
-    char *ssid = strstr(buf, "ssid=");
-    char *password = strstr(buf, "password=");
-    char *websocket = strstr(buf, "websocket=");
-
-    if (ssid && password && websocket) {
-        ssid += 5;
-        password += 9;
-        websocket += 10;
-
-        char *end;
-        end = strchr(ssid, '&');
-        if (end) *end = '\0';
-        end = strchr(password, '&');
-        if (end) *end = '\0';
-        end = strchr(websocket, '&');
-        if (end) *end = '\0';
-
-        strncpy(current_config.wifi_ssid, ssid, sizeof(current_config.wifi_ssid) - 1);
-        strncpy(current_config.wifi_password, password, sizeof(current_config.wifi_password) - 1);
-        strncpy(current_config.websocket_server, websocket, sizeof(current_config.websocket_server) - 1);
-
-        config_manager_save(&current_config);
-        
-        const char *response = "<html><body><h2>Configuration saved! Device will restart.</h2></body></html>";
-        httpd_resp_send(req, response, strlen(response));
-        
-        // Restart after a short delay
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        esp_restart();
-    }
+static const char *SCHEMA_KEY = "schema";
+static const char *LEGACY_CONFIG_KEY = "config_data";
+
+// Schema 1 stored this struct whole under LEGACY_CONFIG_KEY
+typedef struct {
+    char wifi_ssid[MAX_SSID_LENGTH];
+    char wifi_password[MAX_PASSWORD_LENGTH];
+    char websocket_server[MAX_WEBSOCKET_LENGTH];
+} device_config_v1_t;
+
+typedef enum {
+    FIELD_STR,
+    FIELD_U8,
+    FIELD_U16,
+    FIELD_BLOB,
+} config_field_type_t;
+
+// Each field has its own NVS key (15 characters max) so one change rewrites one entry
+typedef struct {
+    const char *key;
+    config_field_type_t type;
+    size_t offset;
+    size_t size;
+} config_field_t;
+
+#define CONFIG_FIELD(key, type, member) \
+    {key, type, offsetof(device_config_t, member), sizeof(((device_config_t *)0)->member)}
+
+static const config_field_t CONFIG_FIELDS[] = {
+    CONFIG_FIELD("wifi_ssid", FIELD_STR, wifi_ssid),
+    CONFIG_FIELD("wifi_pass", FIELD_STR, wifi_password),
+    CONFIG_FIELD("ws_server", FIELD_STR, websocket_server),
+    CONFIG_FIELD("portal_pass", FIELD_STR, portal_password),
+    CONFIG_FIELD("day_bright", FIELD_U8, lights.brightness.day_brightness),
+    CONFIG_FIELD("night_bright", FIELD_U8, lights.brightness.night_brightness),
+    CONFIG_FIELD("night_start", FIELD_U8, lights.brightness.night_start_hour),
+    CONFIG_FIELD("night_end", FIELD_U8, lights.brightness.night_end_hour),
+    CONFIG_FIELD("timezone", FIELD_STR, lights.timezone),
+    CONFIG_FIELD("power_ma", FIELD_U16, lights.power_budget_ma),
+    CONFIG_FIELD("segments", FIELD_BLOB, lights.segments),
+};
 
-    return ESP_OK;
-}
+#define CONFIG_FIELD_COUNT (sizeof(CONFIG_FIELDS) / sizeof(CONFIG_FIELDS[0]))
 
-static httpd_uri_t root = {
-    .uri = "/",
-    .method = HTTP_GET,
-    .handler = root_get_handler,
-    .user_ctx = NULL
+static const device_config_t CONFIG_DEFAULTS = {
+    .lights = {
+        .brightness = {
+            .day_brightness = 255,
+            .night_brightness = 48,
+            .night_start_hour = 22,
+            .night_end_hour = 7,
+        },
+        .timezone = "UTC0",
+        .power_budget_ma = 1500,
+        // LED positions for each the 6 segments
+        .segments = {
+            {0, 13},
+            {13, 24},
+            {24, 36},
+            {37, 50},
+            {50, 60},
+            {61, 74},
+        },
+    },
 };
 
-static httpd_uri_t save = {
-    .uri = "/save",
-    .method = HTTP_POST,
-    .handler = save_post_handler,
-    .user_ctx = NULL
-};
+// Loaded once at boot, NVS is only touched again to write changed fields
+static device_config_t cache;
+static bool configured = false;
+static portMUX_TYPE cacheLock = portMUX_INITIALIZER_UNLOCKED;
+
+static void config_cache_load(void);
 
 #define BUTTON_GPIO GPIO_NUM_0  // Boot button on most ESP32 boards
 #define LONG_PRESS_TIME_MS 300  // 3 seconds for long press
@@ -160,6 +130,8 @@ void config_manager_init(void)
     }
     ESP_ERROR_CHECK(ret);
 
+    config_cache_load();
+
     // Setup button for long-press detection
     gpio_config_t io_conf = {
         .pin_bit_mask = (1ULL << BUTTON_GPIO),
@@ -180,24 +152,163 @@ void config_manager_init(void)
     }
 }
 
+static esp_err_t field_read(nvs_handle_t handle, const config_field_t *field, device_config_t *config)
+{
+    void *value = (char *)config + field->offset;
+    size_t size = field->size;
+    esp_err_t err;
+
+    switch (field->type) {
+    case FIELD_STR:
+        return nvs_get_str(handle, field->key, value, &size);
+    case FIELD_U8:
+        return nvs_get_u8(handle, field->key, value);
+    case FIELD_U16:
+        return nvs_get_u16(handle, field->key, value);
+    case FIELD_BLOB:
+        err = nvs_get_blob(handle, field->key, NULL, &size);
+        if (err == ESP_OK && size != field->size) return ESP_ERR_NVS_INVALID_LENGTH;
+        if (err != ESP_OK) return err;
+        return nvs_get_blob(handle, field->key, value, &size);
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t field_write(nvs_handle_t handle, const config_field_t *field, const device_config_t *config)
+{
+    const void *value = (const char *)config + field->offset;
+
+    switch (field->type) {
+    case FIELD_STR:
+        return nvs_set_str(handle, field->key, value);
+    case FIELD_U8:
+        return nvs_set_u8(handle, field->key, *(const uint8_t *)value);
+    case FIELD_U16:
+        return nvs_set_u16(handle, field->key, *(const uint16_t *)value);
+    case FIELD_BLOB:
+        return nvs_set_blob(handle, field->key, value, field->size);
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static bool field_changed(const config_field_t *field, const device_config_t *a, const device_config_t *b)
+{
+    const char *valueA = (const char *)a + field->offset;
+    const char *valueB = (const char *)b + field->offset;
+    if (field->type == FIELD_STR) {
+        return strncmp(valueA, valueB, field->size) != 0;
+    }
+    return memcmp(valueA, valueB, field->size) != 0;
+}
+
+// Moves a schema 1 blob to per-field keys
+static void config_migrate(nvs_handle_t handle)
+{
+    uint8_t schema = 0;
+    if (nvs_get_u8(handle, SCHEMA_KEY, &schema) == ESP_OK && schema >= CONFIG_SCHEMA_VERSION) {
+        return;
+    }
+
+    device_config_v1_t legacy;
+    size_t size = sizeof(legacy);
+    if (nvs_get_blob(handle, LEGACY_CONFIG_KEY, &legacy, &size) == ESP_OK && size == sizeof(legacy)) {
+        ESP_LOGI(TAG, "Migrating configuration from schema 1");
+        device_config_t migrated = CONFIG_DEFAULTS;
+        memcpy(migrated.wifi_ssid, legacy.wifi_ssid, sizeof(legacy.wifi_ssid) - 1);
+        memcpy(migrated.wifi_password, legacy.wifi_password, sizeof(legacy.wifi_password) - 1);
+        memcpy(migrated.websocket_server, legacy.websocket_server, sizeof(legacy.websocket_server) - 1);
+        for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+            ESP_ERROR_CHECK(field_write(handle, &CONFIG_FIELDS[i], &migrated));
+        }
+        nvs_erase_key(handle, LEGACY_CONFIG_KEY);
+    }
+
+    ESP_ERROR_CHECK(nvs_set_u8(handle, SCHEMA_KEY, CONFIG_SCHEMA_VERSION));
+    ESP_ERROR_CHECK(nvs_commit(handle));
+}
+
+static void config_cache_load(void)
+{
+    device_config_t loaded = CONFIG_DEFAULTS;
+    nvs_handle_t handle;
+
+    if (nvs_open(CONFIG_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        config_migrate(handle);
+        // Fields missing from NVS keep their defaults
+        for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+            field_read(handle, &CONFIG_FIELDS[i], &loaded);
+        }
+        nvs_close(handle);
+    }
+
+    if (!lights_settings_valid(&loaded.lights)) {
+        ESP_LOGW(TAG, "Stored light settings invalid, using defaults");
+        loaded.lights = CONFIG_DEFAULTS.lights;
+    }
+
+    cache = loaded;
+    configured = cache.wifi_ssid[0] != '\0' && cache.websocket_server[0] != '\0';
+}
+
 bool config_manager_load(device_config_t *config)
+{
+    portENTER_CRITICAL(&cacheLock);
+    *config = cache;
+    bool result = configured;
+    portEXIT_CRITICAL(&cacheLock);
+    return result;
+}
+
+void config_manager_save(const device_config_t *config)
+{
+    nvs_handle_t handle;
+    int written = 0;
+
+    ESP_ERROR_CHECK(nvs_open(CONFIG_NAMESPACE, NVS_READWRITE, &handle));
+    for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        if (field_changed(&CONFIG_FIELDS[i], config, &cache)) {
+            ESP_ERROR_CHECK(field_write(handle, &CONFIG_FIELDS[i], config));
+            written++;
+        }
+    }
+    if (written > 0) {
+        ESP_ERROR_CHECK(nvs_commit(handle));
+    }
+    nvs_close(handle);
+
+    portENTER_CRITICAL(&cacheLock);
+    cache = *config;
+    configured = cache.wifi_ssid[0] != '\0' && cache.websocket_server[0] != '\0';
+    portEXIT_CRITICAL(&cacheLock);
+
+    ESP_LOGI(TAG, "Saved %d changed configuration fields", written);
+}
+
+bool config_manager_load_blob(const char *key, void *data, size_t *size)
 {
     nvs_handle_t handle;
     esp_err_t err = nvs_open(CONFIG_NAMESPACE, NVS_READONLY, &handle);
     if (err != ESP_OK) return false;
 
-    size_t required_size = sizeof(device_config_t);
-    err = nvs_get_blob(handle, CONFIG_KEY, config, &required_size);
+    err = nvs_get_blob(handle, key, data, size);
     nvs_close(handle);
 
     return (err == ESP_OK);
 }
 
-void config_manager_save(const device_config_t *config)
+void config_manager_save_blob(const char *key, const void *data, size_t size)
 {
+    // Skip the write when the stored blob is already identical
+    void *stored = malloc(size);
+    size_t storedSize = size;
+    bool same = stored && config_manager_load_blob(key, stored, &storedSize) &&
+                storedSize == size && memcmp(stored, data, size) == 0;
+    free(stored);
+    if (same) return;
+
     nvs_handle_t handle;
     ESP_ERROR_CHECK(nvs_open(CONFIG_NAMESPACE, NVS_READWRITE, &handle));
-    ESP_ERROR_CHECK(nvs_set_blob(handle, CONFIG_KEY, config, sizeof(device_config_t)));
+    ESP_ERROR_CHECK(nvs_set_blob(handle, key, data, size));
     ESP_ERROR_CHECK(nvs_commit(handle));
     nvs_close(handle);
 }
@@ -228,27 +339,10 @@ void config_manager_start_ap(void)
     ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_AP, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
 
-    httpd_config_t server_config = HTTPD_DEFAULT_CONFIG();
-    server_config.lru_purge_enable = true;
-    server_config.max_uri_handlers = 8;
-    server_config.max_resp_headers = 8;
-    server_config.stack_size = 16384;
-    server_config.recv_wait_timeout = 20;
-    server_config.send_wait_timeout = 20;
-    server_config.max_open_sockets = 4;
-    server_config.backlog_conn = 5;
-
-    if (httpd_start(&server, &server_config) == ESP_OK) {
-        httpd_register_uri_handler(server, &root);
-        httpd_register_uri_handler(server, &save);
-        ESP_LOGI(TAG, "HTTP server started");
-    } else {
-        ESP_LOGE(TAG, "Failed to start HTTP server");
-    }
+    config_portal_start();
 }
 
 bool config_manager_is_configured(void)
 {
-    device_config_t config;
-    return config_manager_load(&config);
+    return configured;
 } 
\ No newline at end of file
@@ -2,21 +2,34 @@
 #define CONFIG_MANAGER_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include "lights.h"
 
 #define MAX_SSID_LENGTH 32
 #define MAX_PASSWORD_LENGTH 64
 #define MAX_WEBSOCKET_LENGTH 128
 
+// Layout of the stored config. Bump and add a migration when fields change meaning.
+// 1: whole device_config_t in one blob, 2: one NVS key per field
+#define CONFIG_SCHEMA_VERSION 2
+
 typedef struct {
     char wifi_ssid[MAX_SSID_LENGTH];
     char wifi_password[MAX_PASSWORD_LENGTH];
     char websocket_server[MAX_WEBSOCKET_LENGTH];
+    char portal_password[MAX_PASSWORD_LENGTH]; // Guards the portal in station mode
+    lights_settings_t lights;
 } device_config_t;
 
 void config_manager_init(void);
+// Copies the cached config, with defaults for unset fields. Returns false until configured.
 bool config_manager_load(device_config_t *config);
+// Writes only the fields that differ from the cached config
 void config_manager_save(const device_config_t *config);
 void config_manager_start_ap(void);
 bool config_manager_is_configured(void);
+// Other settings stored alongside the device config, cleared by the same factory reset
+bool config_manager_load_blob(const char *key, void *data, size_t *size);
+void config_manager_save_blob(const char *key, const void *data, size_t size);
 
-#endif // CONFIG_MANAGER_H 
\ No newline at end of file
+#endif // CONFIG_MANAGER_H
@@ -0,0 +1,708 @@
+#include "config_portal.h"
+#include "config_manager.h"
+#include "effect_rules.h"
+#include "form_parser.h"
+#include "lights.h"
+#include "sys_stats.h"
+#include "websocket.h"
+#include "cJSON.h"
+#include "esp_app_desc.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+#include "mbedtls/base64.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+static const char *TAG = "CONFIG_PORTAL";
+
+#define MAX_FORM_LENGTH 1024
+#define FORM_CHUNK_SIZE 128
+#define OTA_CHUNK_SIZE 1024
+#define STATS_TEXT_SIZE 1536
+#define RESTART_DELAY_MS 1000
+#define AUTH_HEADER_SIZE 128
+#define AUTH_REALM "Basic realm=\"BITAXE LED\""
+
+static httpd_handle_t server = NULL;
+static TimerHandle_t restart_timer = NULL;
+
+static const char *HTML_FORM =
+    "<!DOCTYPE html><html><head><title>BITAXE LED Configuration</title>"
+    "<style>body{font-family:Arial,sans-serif;max-width:600px;margin:0 auto;padding:20px}"
+    "input{width:100%;padding:8px;margin:5px 0;border:1px solid #ddd;border-radius:4px}"
+    "button{background:#4CAF50;color:white;padding:10px 15px;border:none;border-radius:4px;cursor:pointer}"
+    "</style></head><body>"
+    "<h2>BITAXE LED Configuration</h2>"
+    "<p><a href='/status'>Status</a></p>"
+    "<form action='/save' method='post'>"
+    "<label>WiFi SSID:</label><br>"
+    "<input type='text' name='ssid' maxlength='31'><br>"
+    "<label>WiFi Password:</label><br>"
+    "<input type='password' name='password' maxlength='63'><br>"
+    "<label>WebSocket Server:</label><br>"
+    "<input type='text' name='websocket' maxlength='127'><br>"
+    "<label>Portal Password (required to use this page from your network):</label><br>"
+    "<input type='password' name='portal_password' maxlength='63'><br>"
+    "<label>Day / Night Brightness (0-255):</label><br>"
+    "<input type='number' name='day_brightness' min='0' max='255'>"
+    "<input type='number' name='night_brightness' min='0' max='255'><br>"
+    "<label>Night Starts / Ends (hour 0-23):</label><br>"
+    "<input type='number' name='night_start' min='0' max='23'>"
+    "<input type='number' name='night_end' min='0' max='23'><br>"
+    "<label>Timezone (POSIX TZ, e.g. UTC0 or CET-1CEST,M3.5.0,M10.5.0/3):</label><br>"
+    "<input type='text' name='timezone' maxlength='47'><br>"
+    // 0 or LIGHTS_MIN_POWER_BUDGET_MA to 65535
+    "<label>Power Budget (mA, 0 for no limit, otherwise at least 75):</label><br>"
+    "<input type='text' name='power_budget' inputmode='numeric' pattern='0|7[5-9]|[89][0-9]|[1-9][0-9]{2,4}'><br>"
+    "<label>Segments (first-last LED, comma separated):</label><br>"
+    "<input type='text' name='segments' placeholder='0-13,13-24,24-36,37-50,50-60,61-74'><br>"
+    "<p>Leave a field blank to keep its current value. Only WiFi and WebSocket changes restart the device.</p>"
+    "<button type='submit'>Save Configuration</button>"
+    "</form>"
+    "<h2>Firmware Update</h2>"
+    "<input type='file' id='firmware' accept='.bin'><br>"
+    "<button onclick='upload()'>Upload Firmware</button>"
+    "<p id='ota'></p>"
+    "<script>function upload(){var f=document.getElementById('firmware').files[0],o=document.getElementById('ota');"
+    "if(!f)return;o.textContent='Uploading...';"
+    "fetch('/ota',{method:'POST',body:f}).then(r=>r.text()).then(t=>o.textContent=t)"
+    ".catch(e=>o.textContent='Upload failed')}</script>"
+    "</body></html>";
+
+static const char *HTML_STATUS =
+    "<!DOCTYPE html><html><head><title>BITAXE LED Status</title>"
+    "<style>body{font-family:Arial,sans-serif;max-width:600px;margin:0 auto;padding:20px}"
+    "td{padding:2px 10px}</style></head><body>"
+    "<h2>BITAXE LED Status</h2>"
+    "<p><a href='/'>Configuration</a></p>"
+    "<table id='status'></table><pre id='tasks'></pre>"
+    "<script>function row(k,v){return '<tr><td>'+k+'</td><td>'+v+'</td></tr>'}"
+    "function flat(p,o,h){for(var k in o){if(k=='tasks')continue;"
+    "if(typeof o[k]=='object')h=flat(p+k+'.',o[k],h);else h+=row(p+k,o[k])}return h}"
+    "function poll(){fetch('/api/status').then(r=>r.json()).then(s=>{"
+    "document.getElementById('status').innerHTML=flat('',s,'');"
+    "document.getElementById('tasks').textContent=s.tasks}).finally(()=>setTimeout(poll,2000))}"
+    "poll()</script></body></html>";
+
+static void restart_timer_callback(TimerHandle_t xTimer)
+{
+    esp_restart();
+}
+
+// Restart once the response has gone out without holding up the server task
+static void schedule_restart(void)
+{
+    if (restart_timer == NULL)
+    {
+        restart_timer = xTimerCreate("restart_timer", pdMS_TO_TICKS(RESTART_DELAY_MS), pdFALSE, NULL, restart_timer_callback);
+    }
+    xTimerStart(restart_timer, 0);
+}
+
+static bool is_json_request(httpd_req_t *req)
+{
+    char contentType[32];
+    return httpd_req_get_hdr_value_str(req, "Content-Type", contentType, sizeof(contentType)) == ESP_OK &&
+           strncmp(contentType, "application/json", 16) == 0;
+}
+
+static esp_err_t send_result(httpd_req_t *req, const char *status, const char *message, bool json)
+{
+    httpd_resp_set_status(req, status);
+    if (json)
+    {
+        cJSON *root = cJSON_CreateObject();
+        cJSON_AddBoolToObject(root, "ok", strcmp(status, HTTPD_200) == 0);
+        cJSON_AddStringToObject(root, "message", message);
+        char *body = cJSON_PrintUnformatted(root);
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, body);
+        free(body);
+        cJSON_Delete(root);
+    }
+    else
+    {
+        httpd_resp_set_type(req, "text/html");
+        httpd_resp_sendstr_chunk(req, "<html><body><h2>");
+        httpd_resp_sendstr_chunk(req, message);
+        httpd_resp_sendstr_chunk(req, "</h2><p><a href='/'>Back</a></p></body></html>");
+        httpd_resp_sendstr_chunk(req, NULL);
+    }
+    return ESP_OK;
+}
+
+// given is zero padded to MAX_PASSWORD_LENGTH. Compares through the stored password's
+// terminator without stopping at the first difference, so the time taken does not
+// depend on how much of the password was right.
+static bool passwords_equal(const char *given, const char *stored)
+{
+    size_t length = strnlen(stored, MAX_PASSWORD_LENGTH - 1) + 1;
+    unsigned char diff = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        diff |= given[i] ^ stored[i];
+    }
+    return diff == 0;
+}
+
+// The setup access point is open, but on the home network the pages that change
+// settings or flash firmware need HTTP basic auth with the portal password.
+// Returns false after sending the rejection.
+static bool check_auth(httpd_req_t *req)
+{
+    wifi_mode_t mode;
+    if (esp_wifi_get_mode(&mode) == ESP_OK && mode == WIFI_MODE_AP)
+    {
+        return true;
+    }
+
+    device_config_t config;
+    config_manager_load(&config);
+    if (config.portal_password[0] == '\0')
+    {
+        send_result(req, "403 Forbidden", "Set a portal password from the setup access point first", false);
+        return false;
+    }
+
+    char header[AUTH_HEADER_SIZE];
+    unsigned char decoded[AUTH_HEADER_SIZE];
+    size_t decodedLen = 0;
+    if (httpd_req_get_hdr_value_str(req, "Authorization", header, sizeof(header)) == ESP_OK &&
+        strncmp(header, "Basic ", 6) == 0 &&
+        mbedtls_base64_decode(decoded, sizeof(decoded) - 1, &decodedLen,
+                              (const unsigned char *)header + 6, strlen(header + 6)) == 0)
+    {
+        // Any user name, the password follows the first ':'
+        decoded[decodedLen] = '\0';
+        char *password = strchr((char *)decoded, ':');
+        char given[MAX_PASSWORD_LENGTH] = {0};
+        if (password && strlen(password + 1) < sizeof(given))
+        {
+            strcpy(given, password + 1);
+            if (passwords_equal(given, config.portal_password))
+            {
+                return true;
+            }
+        }
+    }
+
+    ESP_LOGW(TAG, "Unauthorized request for %s", req->uri);
+    httpd_resp_set_hdr(req, "WWW-Authenticate", AUTH_REALM);
+    send_result(req, "401 Unauthorized", "Unauthorized", false);
+    return false;
+}
+
+static esp_err_t root_get_handler(httpd_req_t *req)
+{
+    if (!check_auth(req))
+    {
+        return ESP_OK;
+    }
+    httpd_resp_set_type(req, "text/html");
+    httpd_resp_send(req, HTML_FORM, strlen(HTML_FORM));
+    return ESP_OK;
+}
+
+typedef struct
+{
+    device_config_t config;
+    const char *error;
+} config_form_t;
+
+static bool parse_number(const char *value, long min, long max, long *out)
+{
+    char *end;
+    long number = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || number < min || number > max)
+    {
+        return false;
+    }
+    *out = number;
+    return true;
+}
+
+// "0-13,13-24,..." with one first-last pair per segment
+static bool parse_segments(const char *value, uint8_t segments[LIGHTS_SEGMENT_COUNT][2])
+{
+    const char *c = value;
+    for (int i = 0; i < LIGHTS_SEGMENT_COUNT; i++)
+    {
+        char *end;
+        long first = strtol(c, &end, 10);
+        if (end == c || *end != '-')
+        {
+            return false;
+        }
+        c = end + 1;
+        long last = strtol(c, &end, 10);
+        if (end == c || first < 0 || last >= LIGHTS_PIXEL_COUNT || first >= last)
+        {
+            return false;
+        }
+        if (*end != (i == LIGHTS_SEGMENT_COUNT - 1 ? '\0' : ','))
+        {
+            return false;
+        }
+        segments[i][0] = first;
+        segments[i][1] = last;
+        c = end + 1;
+    }
+    return true;
+}
+
+static bool set_number_field(const char *key, const char *value, lights_settings_t *lights, bool *valid)
+{
+    long number;
+    if (strcmp(key, "day_brightness") == 0)
+    {
+        *valid = parse_number(value, 0, 255, &number);
+        lights->brightness.day_brightness = *valid ? number : lights->brightness.day_brightness;
+    }
+    else if (strcmp(key, "night_brightness") == 0)
+    {
+        *valid = parse_number(value, 0, 255, &number);
+        lights->brightness.night_brightness = *valid ? number : lights->brightness.night_brightness;
+    }
+    else if (strcmp(key, "night_start") == 0)
+    {
+        *valid = parse_number(value, 0, 23, &number);
+        lights->brightness.night_start_hour = *valid ? number : lights->brightness.night_start_hour;
+    }
+    else if (strcmp(key, "night_end") == 0)
+    {
+        *valid = parse_number(value, 0, 23, &number);
+        lights->brightness.night_end_hour = *valid ? number : lights->brightness.night_end_hour;
+    }
+    else if (strcmp(key, "power_budget") == 0)
+    {
+        *valid = parse_number(value, 0, UINT16_MAX, &number);
+        lights->power_budget_ma = *valid ? number : lights->power_budget_ma;
+    }
+    else if (strcmp(key, "segments") == 0)
+    {
+        *valid = parse_segments(value, lights->segments);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// Blank fields keep the current value
+static void config_form_field(void *ctx, const char *key, const char *value, bool truncated)
+{
+    config_form_t *form = (config_form_t *)ctx;
+    char *field;
+    size_t size;
+    bool valid;
+
+    if (truncated)
+    {
+        form->error = "Field too long";
+        return;
+    }
+    if (value[0] == '\0')
+    {
+        return;
+    }
+
+    if (strcmp(key, "ssid") == 0)
+    {
+        field = form->config.wifi_ssid;
+        size = sizeof(form->config.wifi_ssid);
+    }
+    else if (strcmp(key, "password") == 0)
+    {
+        field = form->config.wifi_password;
+        size = sizeof(form->config.wifi_password);
+    }
+    else if (strcmp(key, "websocket") == 0)
+    {
+        field = form->config.websocket_server;
+        size = sizeof(form->config.websocket_server);
+    }
+    else if (strcmp(key, "timezone") == 0)
+    {
+        field = form->config.lights.timezone;
+        size = sizeof(form->config.lights.timezone);
+    }
+    else if (strcmp(key, "portal_password") == 0)
+    {
+        field = form->config.portal_password;
+        size = sizeof(form->config.portal_password);
+    }
+    else
+    {
+        if (set_number_field(key, value, &form->config.lights, &valid) && !valid)
+        {
+            form->error = "Invalid light settings";
+        }
+        return;
+    }
+
+    if (strlen(value) >= size)
+    {
+        form->error = "Field too long";
+        return;
+    }
+    // Pads with zeros so no tail of a longer previous value is left behind the terminator
+    strncpy(field, value, size);
+}
+
+static const char *config_validate(const device_config_t *config)
+{
+    size_t passwordLength = strlen(config->wifi_password);
+    if (config->wifi_ssid[0] == '\0')
+    {
+        return "WiFi SSID is required";
+    }
+    if (passwordLength > 0 && passwordLength < 8)
+    {
+        return "WiFi password must be at least 8 characters";
+    }
+    if (config->websocket_server[0] == '\0')
+    {
+        return "WebSocket server is required";
+    }
+    for (const char *c = config->websocket_server; *c; c++)
+    {
+        if (!isalnum((unsigned char)*c) && *c != '.' && *c != '-')
+        {
+            return "WebSocket server must be a host name or IP address";
+        }
+    }
+    if (config->lights.power_budget_ma != 0 && config->lights.power_budget_ma < LIGHTS_MIN_POWER_BUDGET_MA)
+    {
+        return "Power budget must be 0 or at least the strip's idle draw";
+    }
+    if (!lights_settings_valid(&config->lights))
+    {
+        return "Invalid light settings";
+    }
+    return NULL;
+}
+
+// Accepts a url-encoded form or a flat JSON object, parsed as it is received
+static esp_err_t save_post_handler(httpd_req_t *req)
+{
+    if (!check_auth(req))
+    {
+        return ESP_OK;
+    }
+    bool json = is_json_request(req);
+    if (req->content_len > MAX_FORM_LENGTH)
+    {
+        ESP_LOGE(TAG, "Request too large: %d bytes", req->content_len);
+        return send_result(req, "413 Content Too Large", "Request too large", json);
+    }
+
+    config_form_t form = {0};
+    device_config_t current;
+    bool configured = config_manager_load(&current);
+    form.config = current;
+
+    form_parser_t parser;
+    form_parser_init(&parser, json ? FORM_PARSER_JSON : FORM_PARSER_URLENCODED, config_form_field, &form);
+
+    char chunk[FORM_CHUNK_SIZE];
+    int ret, remaining = req->content_len;
+    while (remaining > 0)
+    {
+        if ((ret = httpd_req_recv(req, chunk, MIN(remaining, sizeof(chunk)))) <= 0)
+        {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+            {
+                continue;
+            }
+            ESP_LOGE(TAG, "Error receiving request data");
+            return ESP_FAIL;
+        }
+        form_parser_feed(&parser, chunk, ret);
+        remaining -= ret;
+    }
+
+    if (!form_parser_finish(&parser))
+    {
+        return send_result(req, HTTPD_400, "Malformed request", json);
+    }
+    const char *error = form.error ? form.error : config_validate(&form.config);
+    if (error)
+    {
+        return send_result(req, HTTPD_400, error, json);
+    }
+
+    config_manager_save(&form.config);
+
+    // Light settings apply live, network settings need a restart
+    bool restart = !configured ||
+                   strcmp(form.config.wifi_ssid, current.wifi_ssid) != 0 ||
+                   strcmp(form.config.wifi_password, current.wifi_password) != 0 ||
+                   strcmp(form.config.websocket_server, current.websocket_server) != 0;
+    if (!restart)
+    {
+        lights_apply_settings(&form.config.lights);
+        return send_result(req, HTTPD_200, "Configuration saved!", json);
+    }
+
+    send_result(req, HTTPD_200, "Configuration saved! Device will restart.", json);
+    schedule_restart();
+    return ESP_OK;
+}
+
+static esp_err_t config_get_handler(httpd_req_t *req)
+{
+    if (!check_auth(req))
+    {
+        return ESP_OK;
+    }
+    device_config_t config = {0};
+    bool configured = config_manager_load(&config);
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "configured", configured);
+    cJSON_AddBoolToObject(root, "portal_password_set", config.portal_password[0] != '\0');
+    cJSON_AddStringToObject(root, "ssid", config.wifi_ssid);
+    cJSON_AddStringToObject(root, "websocket", config.websocket_server);
+    cJSON_AddNumberToObject(root, "day_brightness", config.lights.brightness.day_brightness);
+    cJSON_AddNumberToObject(root, "night_brightness", config.lights.brightness.night_brightness);
+    cJSON_AddNumberToObject(root, "night_start", config.lights.brightness.night_start_hour);
+    cJSON_AddNumberToObject(root, "night_end", config.lights.brightness.night_end_hour);
+    cJSON_AddStringToObject(root, "timezone", config.lights.timezone);
+    cJSON_AddNumberToObject(root, "power_budget", config.lights.power_budget_ma);
+
+    char segments[LIGHTS_SEGMENT_COUNT * 8];
+    size_t used = 0;
+    for (int i = 0; i < LIGHTS_SEGMENT_COUNT; i++)
+    {
+        used += snprintf(segments + used, sizeof(segments) - used, "%s%d-%d", i ? "," : "",
+                         config.lights.segments[i][0], config.lights.segments[i][1]);
+    }
+    cJSON_AddStringToObject(root, "segments", segments);
+
+    char *body = cJSON_PrintUnformatted(root);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, body);
+    free(body);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+// Firmware image in the request body, written to the inactive OTA partition as it arrives
+static esp_err_t ota_post_handler(httpd_req_t *req)
+{
+    // The server handles one request at a time so a static buffer keeps it off the stack
+    static char chunk[OTA_CHUNK_SIZE];
+
+    if (!check_auth(req))
+    {
+        return ESP_OK;
+    }
+    if (req->content_len == 0)
+    {
+        return send_result(req, HTTPD_400, "No firmware image", false);
+    }
+
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    if (partition == NULL)
+    {
+        return send_result(req, HTTPD_500, "No OTA partition", false);
+    }
+
+    // Sequential writes erase each sector just before it is written instead of the whole
+    // partition up front, so the flash never stalls the render core for long
+    esp_ota_handle_t ota;
+    esp_err_t err = esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &ota);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "OTA begin failed: %s", esp_err_to_name(err));
+        return send_result(req, HTTPD_500, "OTA begin failed", false);
+    }
+
+    ESP_LOGI(TAG, "Writing %d byte firmware to %s", req->content_len, partition->label);
+    int ret, remaining = req->content_len;
+    while (remaining > 0)
+    {
+        if ((ret = httpd_req_recv(req, chunk, MIN(remaining, sizeof(chunk)))) <= 0)
+        {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+            {
+                continue;
+            }
+            ESP_LOGE(TAG, "Error receiving firmware");
+            esp_ota_abort(ota);
+            return ESP_FAIL;
+        }
+        err = esp_ota_write(ota, chunk, ret);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(err));
+            esp_ota_abort(ota);
+            return send_result(req, HTTPD_500, "OTA write failed", false);
+        }
+        remaining -= ret;
+    }
+
+    err = esp_ota_end(ota);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "OTA end failed: %s", esp_err_to_name(err));
+        return send_result(req, HTTPD_400, "Invalid firmware image", false);
+    }
+    err = esp_ota_set_boot_partition(partition);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Set boot partition failed: %s", esp_err_to_name(err));
+        return send_result(req, HTTPD_500, "Set boot partition failed", false);
+    }
+
+    ESP_LOGI(TAG, "Firmware update complete, restarting");
+    httpd_resp_sendstr(req, "Firmware updated, restarting");
+    schedule_restart();
+    return ESP_OK;
+}
+
+static esp_err_t status_page_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/html");
+    httpd_resp_send(req, HTML_STATUS, strlen(HTML_STATUS));
+    return ESP_OK;
+}
+
+static esp_err_t status_get_handler(httpd_req_t *req)
+{
+    lights_stats_t lights;
+    websocket_stats_t ws;
+    wifi_ap_record_t ap;
+    lights_get_stats(&lights);
+    websocket_get_stats(&ws);
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "uptime_s", esp_timer_get_time() / 1000000);
+    cJSON_AddNumberToObject(root, "free_heap", esp_get_free_heap_size());
+    cJSON_AddNumberToObject(root, "min_free_heap", esp_get_minimum_free_heap_size());
+    cJSON_AddStringToObject(root, "firmware", esp_app_get_description()->version);
+    cJSON_AddStringToObject(root, "partition", esp_ota_get_running_partition()->label);
+    cJSON_AddNumberToObject(root, "rules_version", effect_rules_version());
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+    {
+        cJSON_AddNumberToObject(root, "wifi_rssi", ap.rssi);
+    }
+
+    cJSON *queue = cJSON_AddObjectToObject(root, "lights");
+    cJSON_AddNumberToObject(queue, "queue_depth", lights.queue_depth);
+    cJSON_AddNumberToObject(queue, "queue_max", lights.queue_max);
+    cJSON_AddNumberToObject(queue, "dropped", lights.dropped);
+    cJSON_AddNumberToObject(queue, "events", lights.events);
+    cJSON_AddNumberToObject(queue, "latency_us", lights.latency_us);
+    cJSON_AddNumberToObject(queue, "max_latency_us", lights.max_latency_us);
+    cJSON_AddNumberToObject(queue, "frames", lights.frames);
+    cJSON_AddNumberToObject(queue, "overruns", lights.overruns);
+    cJSON_AddNumberToObject(queue, "max_render_us", lights.max_render_us);
+
+    cJSON *connection = cJSON_AddObjectToObject(root, "websocket");
+    cJSON_AddBoolToObject(connection, "connected", ws.connected);
+    cJSON_AddNumberToObject(connection, "connects", ws.connects);
+    cJSON_AddNumberToObject(connection, "disconnects", ws.disconnects);
+    cJSON_AddNumberToObject(connection, "messages", ws.messages);
+    cJSON_AddNumberToObject(connection, "errors", ws.errors);
+
+    // CPU use since the previous poll, kept apart from the minute the log reports on
+    static sys_stats_sample_t previous;
+    char *tasks = malloc(STATS_TEXT_SIZE);
+    if (tasks)
+    {
+        sys_stats_format(&previous, tasks, STATS_TEXT_SIZE);
+        cJSON_AddStringToObject(root, "tasks", tasks);
+        free(tasks);
+    }
+
+    char *body = cJSON_PrintUnformatted(root);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, body);
+    free(body);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static httpd_uri_t root = {
+    .uri = "/",
+    .method = HTTP_GET,
+    .handler = root_get_handler,
+    .user_ctx = NULL
+};
+
+static httpd_uri_t save = {
+    .uri = "/save",
+    .method = HTTP_POST,
+    .handler = save_post_handler,
+    .user_ctx = NULL
+};
+
+static httpd_uri_t config = {
+    .uri = "/api/config",
+    .method = HTTP_GET,
+    .handler = config_get_handler,
+    .user_ctx = NULL
+};
+
+static httpd_uri_t ota = {
+    .uri = "/ota",
+    .method = HTTP_POST,
+    .handler = ota_post_handler,
+    .user_ctx = NULL
+};
+
+static httpd_uri_t status_page = {
+    .uri = "/status",
+    .method = HTTP_GET,
+    .handler = status_page_handler,
+    .user_ctx = NULL
+};
+
+static httpd_uri_t status = {
+    .uri = "/api/status",
+    .method = HTTP_GET,
+    .handler = status_get_handler,
+    .user_ctx = NULL
+};
+
+void config_portal_start(void)
+{
+    if (server != NULL)
+    {
+        return;
+    }
+
+    httpd_config_t server_config = HTTPD_DEFAULT_CONFIG();
+    server_config.lru_purge_enable = true;
+    server_config.max_uri_handlers = 8;
+    server_config.max_resp_headers = 8;
+    server_config.stack_size = 6144;
+    server_config.core_id = 0; // Protocol core, away from the render task
+    server_config.recv_wait_timeout = 20;
+    server_config.send_wait_timeout = 20;
+    server_config.max_open_sockets = 4;
+    server_config.backlog_conn = 5;
+
+    if (httpd_start(&server, &server_config) == ESP_OK) {
+        httpd_register_uri_handler(server, &root);
+        httpd_register_uri_handler(server, &save);
+        httpd_register_uri_handler(server, &config);
+        httpd_register_uri_handler(server, &ota);
+        httpd_register_uri_handler(server, &status_page);
+        httpd_register_uri_handler(server, &status);
+        ESP_LOGI(TAG, "HTTP server started");
+    } else {
+        ESP_LOGE(TAG, "Failed to start HTTP server");
+    }
+}
@@ -0,0 +1,7 @@
+#ifndef CONFIG_PORTAL_H
+#define CONFIG_PORTAL_H
+
+// HTTP configuration, status and OTA endpoints. Runs in both AP and station mode.
+void config_portal_start(void);
+
+#endif // CONFIG_PORTAL_H
@@ -0,0 +1,289 @@
+#include "effect_rules.h"
+#include "config_manager.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "EFFECT_RULES";
+static const char *RULES_KEY = "effect_rules";
+
+static const char *const EFFECT_NAMES[EFFECT_COUNT] = {
+    [EFFECT_NONE] = "none",
+    [EFFECT_SEGMENT_FILL] = "segment_fill",
+    [EFFECT_SEGMENT_FLASH] = "segment_flash",
+    [EFFECT_BAR_FLASH] = "bar_flash",
+    [EFFECT_PRICE] = "price",
+    [EFFECT_POLICE] = "police",
+};
+
+static const effect_rule_set_t DEFAULT_RULES = {
+    .version = 0,
+    .count = 5,
+    .rules = {
+        {.event = LIGHTS_EVENT_MINING_SUBMIT, .effect = EFFECT_SEGMENT_FILL, .repeat = 1, .color = 0x826000},
+        {.event = LIGHTS_EVENT_MINING_NOTIFY, .effect = EFFECT_SEGMENT_FLASH, .repeat = 5, .color = 0xE3DA34},
+        {.event = LIGHTS_EVENT_TX, .effect = EFFECT_BAR_FLASH, .repeat = 2, .color = 0x127D04},
+        {.event = LIGHTS_EVENT_PRICE, .effect = EFFECT_PRICE},
+        {.event = LIGHTS_EVENT_BLOCK, .effect = EFFECT_BAR_FLASH, .repeat = 10, .color = 0x787878},
+    },
+};
+
+// Active rules grouped by event type so dispatch only looks at that type's rules
+static effect_rule_set_t active;
+static uint8_t ruleStart[LIGHTS_EVENT_TYPE_COUNT];
+static uint8_t ruleCount[LIGHTS_EVENT_TYPE_COUNT];
+static portMUX_TYPE rulesLock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool rule_valid(const effect_rule_t *rule)
+{
+    return rule->event != LIGHTS_EVENT_UNKNOWN && rule->event < LIGHTS_EVENT_TYPE_COUNT &&
+           rule->effect < EFFECT_COUNT &&
+           (rule->segments >> LIGHTS_SEGMENT_COUNT) == 0;
+}
+
+static void rules_install(const effect_rule_set_t *set)
+{
+    static effect_rule_set_t sorted;
+    uint8_t start[LIGHTS_EVENT_TYPE_COUNT] = {0};
+    uint8_t count[LIGHTS_EVENT_TYPE_COUNT] = {0};
+
+    for (int i = 0; i < set->count; i++)
+    {
+        count[set->rules[i].event]++;
+    }
+    for (int type = 1; type < LIGHTS_EVENT_TYPE_COUNT; type++)
+    {
+        start[type] = start[type - 1] + count[type - 1];
+    }
+
+    // Stable grouping keeps the hub's rule order within each event type
+    uint8_t next[LIGHTS_EVENT_TYPE_COUNT];
+    memcpy(next, start, sizeof(next));
+    sorted.version = set->version;
+    sorted.count = set->count;
+    for (int i = 0; i < set->count; i++)
+    {
+        sorted.rules[next[set->rules[i].event]++] = set->rules[i];
+    }
+
+    portENTER_CRITICAL(&rulesLock);
+    active = sorted;
+    memcpy(ruleStart, start, sizeof(ruleStart));
+    memcpy(ruleCount, count, sizeof(ruleCount));
+    portEXIT_CRITICAL(&rulesLock);
+}
+
+static size_t rules_stored_size(uint8_t count)
+{
+    return offsetof(effect_rule_set_t, rules) + count * sizeof(effect_rule_t);
+}
+
+void effect_rules_init(void)
+{
+    static effect_rule_set_t stored;
+    size_t size = sizeof(stored);
+    bool valid = config_manager_load_blob(RULES_KEY, &stored, &size) &&
+                 size >= offsetof(effect_rule_set_t, rules) &&
+                 stored.count <= EFFECT_RULES_MAX &&
+                 size == rules_stored_size(stored.count);
+    for (int i = 0; valid && i < stored.count; i++)
+    {
+        valid = rule_valid(&stored.rules[i]);
+    }
+
+    if (valid)
+    {
+        ESP_LOGI(TAG, "Loaded %d effect rules, version %lu", stored.count, (unsigned long)stored.version);
+        rules_install(&stored);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Using default effect rules");
+        rules_install(&DEFAULT_RULES);
+    }
+}
+
+uint32_t effect_rules_version(void)
+{
+    portENTER_CRITICAL(&rulesLock);
+    uint32_t version = active.version;
+    portEXIT_CRITICAL(&rulesLock);
+    return version;
+}
+
+bool effect_rules_match(const blink_event_t *event, effect_rule_t *rule)
+{
+    if (event->type == LIGHTS_EVENT_UNKNOWN || event->type >= LIGHTS_EVENT_TYPE_COUNT)
+    {
+        return false;
+    }
+
+    uint8_t segmentBit = (event->segment >= 1 && event->segment <= LIGHTS_SEGMENT_COUNT)
+                             ? 1 << (event->segment - 1)
+                             : 0;
+    bool found = false;
+
+    portENTER_CRITICAL(&rulesLock);
+    int end = ruleStart[event->type] + ruleCount[event->type];
+    for (int i = ruleStart[event->type]; i < end; i++)
+    {
+        const effect_rule_t *candidate = &active.rules[i];
+        if ((candidate->segments == 0 || (candidate->segments & segmentBit)) &&
+            event->value >= candidate->min_value)
+        {
+            *rule = *candidate;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&rulesLock);
+
+    return found;
+}
+
+static lights_effect_t effect_from_string(const char *name)
+{
+    for (int i = 0; i < EFFECT_COUNT; i++)
+    {
+        if (strcmp(name, EFFECT_NAMES[i]) == 0)
+        {
+            return i;
+        }
+    }
+    return EFFECT_COUNT;
+}
+
+// {"event":"tx","effect":"bar_flash","segments":[1,2],"min_value":0,"color":"#127d04","repeat":2,"duration":1500}
+static bool rule_from_json(const cJSON *item, effect_rule_t *rule)
+{
+    cJSON *event = cJSON_GetObjectItem(item, "event");
+    cJSON *effect = cJSON_GetObjectItem(item, "effect");
+    if (!cJSON_IsString(event) || !cJSON_IsString(effect))
+    {
+        return false;
+    }
+
+    memset(rule, 0, sizeof(*rule));
+    rule->event = lights_event_type_from_string(event->valuestring);
+    rule->effect = effect_from_string(effect->valuestring);
+
+    cJSON *segments = cJSON_GetObjectItem(item, "segments");
+    cJSON *segment;
+    cJSON_ArrayForEach(segment, segments)
+    {
+        if (!cJSON_IsNumber(segment) || segment->valueint < 1 || segment->valueint > LIGHTS_SEGMENT_COUNT)
+        {
+            return false;
+        }
+        rule->segments |= 1 << (segment->valueint - 1);
+    }
+
+    cJSON *minValue = cJSON_GetObjectItem(item, "min_value");
+    if (cJSON_IsNumber(minValue))
+    {
+        rule->min_value = (int64_t)minValue->valuedouble;
+    }
+
+    cJSON *repeat = cJSON_GetObjectItem(item, "repeat");
+    if (cJSON_IsNumber(repeat))
+    {
+        if (repeat->valueint < 0 || repeat->valueint > UINT8_MAX)
+        {
+            return false;
+        }
+        rule->repeat = repeat->valueint;
+    }
+
+    cJSON *duration = cJSON_GetObjectItem(item, "duration");
+    if (cJSON_IsNumber(duration))
+    {
+        if (duration->valueint < 0 || duration->valueint > UINT16_MAX)
+        {
+            return false;
+        }
+        rule->duration_ms = duration->valueint;
+    }
+
+    cJSON *color = cJSON_GetObjectItem(item, "color");
+    if (cJSON_IsString(color) && color->valuestring[0] == '#')
+    {
+        char *end;
+        rule->color = strtoul(color->valuestring + 1, &end, 16);
+        if (*end != '\0' || strlen(color->valuestring) != 7)
+        {
+            return false;
+        }
+    }
+    else if (cJSON_IsNumber(color))
+    {
+        rule->color = (uint32_t)color->valuedouble & 0xFFFFFF;
+    }
+    else if (color)
+    {
+        return false;
+    }
+
+    return rule_valid(rule);
+}
+
+// Version must be a whole number that fits uint32_t, converting anything else is undefined
+static bool version_from_json(const cJSON *item, uint32_t *version)
+{
+    if (!cJSON_IsNumber(item))
+    {
+        return false;
+    }
+    double value = item->valuedouble;
+    if (!(value >= 0 && value <= UINT32_MAX) || (double)(uint32_t)value != value)
+    {
+        return false;
+    }
+    *version = (uint32_t)value;
+    return true;
+}
+
+bool effect_rules_apply_json(const cJSON *root)
+{
+    static effect_rule_set_t set;
+    uint32_t versionNumber;
+
+    cJSON *version = cJSON_GetObjectItem(root, "version");
+    cJSON *rules = cJSON_GetObjectItem(root, "rules");
+    if (!version_from_json(version, &versionNumber) || !cJSON_IsArray(rules))
+    {
+        ESP_LOGE(TAG, "Rules message missing a valid version or rules");
+        return false;
+    }
+
+    if (versionNumber == effect_rules_version())
+    {
+        ESP_LOGI(TAG, "Effect rules already at version %lu", (unsigned long)effect_rules_version());
+        return true;
+    }
+
+    int count = cJSON_GetArraySize(rules);
+    if (count > EFFECT_RULES_MAX)
+    {
+        ESP_LOGE(TAG, "Too many effect rules: %d", count);
+        return false;
+    }
+
+    memset(&set, 0, sizeof(set));
+    set.version = versionNumber;
+    set.count = count;
+    for (int i = 0; i < count; i++)
+    {
+        if (!rule_from_json(cJSON_GetArrayItem(rules, i), &set.rules[i]))
+        {
+            ESP_LOGE(TAG, "Invalid effect rule %d", i);
+            return false;
+        }
+    }
+
+    rules_install(&set);
+    config_manager_save_blob(RULES_KEY, &set, rules_stored_size(set.count));
+    ESP_LOGI(TAG, "Installed %d effect rules, version %lu", set.count, (unsigned long)set.version);
+    return true;
+}
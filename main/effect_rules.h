@@ -0,0 +1,51 @@
+#ifndef EFFECT_RULES_H
+#define EFFECT_RULES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cJSON.h"
+#include "lights.h"
+
+typedef enum
+{
+    EFFECT_NONE = 0,
+    EFFECT_SEGMENT_FILL,  // Fill the event segment, hold, then flash it
+    EFFECT_SEGMENT_FLASH, // Flash the event segment
+    EFFECT_BAR_FLASH,     // Run a bar along the strip, then flash the strip
+    EFFECT_PRICE,         // Sweep up or down depending on the last price
+    EFFECT_POLICE,        // Alternate colours on every other pixel
+    EFFECT_COUNT
+} lights_effect_t;
+
+// Rule matching an event to an effect. The first matching rule for an event type wins.
+typedef struct
+{
+    uint8_t event;        // lights_event_type_t
+    uint8_t effect;       // lights_effect_t
+    uint8_t segments;     // Bit n matches segment n + 1, 0 matches any segment
+    uint8_t repeat;       // Flash count, 0 uses the effect default
+    uint16_t duration_ms; // Total effect length, 0 uses the effect default
+    uint32_t color;       // 0xRRGGBB, 0 uses the effect default
+    int64_t min_value;    // Matches events with value >= min_value
+} effect_rule_t;
+
+#define EFFECT_RULES_MAX 16
+// Largest rules message accepted from the hub. A fully specified rule is about 155 bytes
+// of compact JSON, so EFFECT_RULES_MAX of them fit with room to spare.
+#define EFFECT_RULES_MAX_MESSAGE 4096
+
+// Version 0 is the built-in default rule set
+typedef struct
+{
+    uint32_t version;
+    uint8_t count;
+    effect_rule_t rules[EFFECT_RULES_MAX];
+} effect_rule_set_t;
+
+void effect_rules_init(void);
+uint32_t effect_rules_version(void);
+bool effect_rules_match(const blink_event_t *event, effect_rule_t *rule);
+// Applies and stores a {"type":"rules","version":n,"rules":[...]} message from the hub
+bool effect_rules_apply_json(const cJSON *root);
+
+#endif // EFFECT_RULES_H
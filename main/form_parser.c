@@ -0,0 +1,304 @@
+#include "form_parser.h"
+#include <string.h>
+
+enum
+{
+    // url-encoded
+    URL_TEXT,
+    URL_PERCENT,
+
+    // JSON
+    JSON_START,
+    JSON_KEY_OR_END,
+    JSON_KEY_START,
+    JSON_KEY,
+    JSON_COLON,
+    JSON_VALUE,
+    JSON_STRING,
+    JSON_STRING_ESCAPE,
+    JSON_STRING_UNICODE,
+    JSON_BARE,
+    JSON_COMMA_OR_END,
+    JSON_DONE,
+};
+
+void form_parser_init(form_parser_t *parser, form_parser_format_t format, form_field_cb_t on_field, void *ctx)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->format = format;
+    parser->on_field = on_field;
+    parser->ctx = ctx;
+    parser->state = format == FORM_PARSER_JSON ? JSON_START : URL_TEXT;
+}
+
+static void append(form_parser_t *parser, char c)
+{
+    if (parser->inValue)
+    {
+        if (parser->valueLen < FORM_PARSER_MAX_VALUE - 1)
+        {
+            parser->value[parser->valueLen++] = c;
+        }
+        else
+        {
+            parser->truncated = true;
+        }
+    }
+    else if (parser->keyLen < FORM_PARSER_MAX_KEY - 1)
+    {
+        parser->key[parser->keyLen++] = c;
+    }
+}
+
+static void emit(form_parser_t *parser)
+{
+    parser->key[parser->keyLen] = '\0';
+    parser->value[parser->valueLen] = '\0';
+    parser->on_field(parser->ctx, parser->key, parser->value, parser->truncated);
+    parser->keyLen = 0;
+    parser->valueLen = 0;
+    parser->truncated = false;
+    parser->inValue = false;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool feed_urlencoded(form_parser_t *parser, char c)
+{
+    switch (parser->state)
+    {
+    case URL_TEXT:
+        if (c == '&')
+        {
+            if (parser->keyLen > 0 || parser->inValue)
+            {
+                emit(parser);
+            }
+        }
+        else if (c == '=' && !parser->inValue)
+        {
+            parser->inValue = true;
+        }
+        else if (c == '%')
+        {
+            parser->escapeLen = 0;
+            parser->state = URL_PERCENT;
+        }
+        else
+        {
+            append(parser, c == '+' ? ' ' : c);
+        }
+        return true;
+    case URL_PERCENT:
+        if (hex_value(c) < 0)
+        {
+            return false;
+        }
+        parser->escape[parser->escapeLen++] = c;
+        if (parser->escapeLen == 2)
+        {
+            append(parser, (char)(hex_value(parser->escape[0]) << 4 | hex_value(parser->escape[1])));
+            parser->state = URL_TEXT;
+        }
+        return true;
+    }
+    return false;
+}
+
+// Appends a \uXXXX code point as UTF-8. Surrogate pairs are not combined.
+static void append_unicode(form_parser_t *parser, unsigned code)
+{
+    if (code < 0x80)
+    {
+        append(parser, code);
+    }
+    else if (code < 0x800)
+    {
+        append(parser, 0xC0 | (code >> 6));
+        append(parser, 0x80 | (code & 0x3F));
+    }
+    else
+    {
+        append(parser, 0xE0 | (code >> 12));
+        append(parser, 0x80 | ((code >> 6) & 0x3F));
+        append(parser, 0x80 | (code & 0x3F));
+    }
+}
+
+static bool feed_json(form_parser_t *parser, char c)
+{
+    switch (parser->state)
+    {
+    case JSON_START:
+        if (is_space(c))
+            return true;
+        parser->state = JSON_KEY_OR_END;
+        return c == '{';
+    case JSON_KEY_OR_END:
+        if (is_space(c))
+            return true;
+        if (c == '}')
+        {
+            parser->state = JSON_DONE;
+            return true;
+        }
+        parser->state = JSON_KEY;
+        return c == '"';
+    case JSON_KEY_START:
+        if (is_space(c))
+            return true;
+        parser->state = JSON_KEY;
+        return c == '"';
+    case JSON_KEY:
+    case JSON_STRING:
+        if (c == '"')
+        {
+            if (parser->state == JSON_KEY)
+            {
+                parser->state = JSON_COLON;
+            }
+            else
+            {
+                emit(parser);
+                parser->state = JSON_COMMA_OR_END;
+            }
+        }
+        else if (c == '\\')
+        {
+            parser->returnState = parser->state;
+            parser->state = JSON_STRING_ESCAPE;
+        }
+        else
+        {
+            append(parser, c);
+        }
+        return true;
+    case JSON_STRING_ESCAPE:
+    {
+        const char *from = "\"\\/bfnrt";
+        const char *to = "\"\\/\b\f\n\r\t";
+        const char *match = strchr(from, c);
+        if (c == 'u')
+        {
+            parser->escapeLen = 0;
+            parser->state = JSON_STRING_UNICODE;
+            return true;
+        }
+        if (c == '\0' || match == NULL)
+        {
+            return false;
+        }
+        append(parser, to[match - from]);
+        parser->state = parser->returnState;
+        return true;
+    }
+    case JSON_STRING_UNICODE:
+        if (hex_value(c) < 0)
+        {
+            return false;
+        }
+        parser->escape[parser->escapeLen++] = c;
+        if (parser->escapeLen == 4)
+        {
+            unsigned code = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                code = code << 4 | hex_value(parser->escape[i]);
+            }
+            append_unicode(parser, code);
+            parser->state = parser->returnState;
+        }
+        return true;
+    case JSON_COLON:
+        if (is_space(c))
+            return true;
+        parser->inValue = true;
+        parser->state = JSON_VALUE;
+        return c == ':';
+    case JSON_VALUE:
+        if (is_space(c))
+            return true;
+        if (c == '"')
+        {
+            parser->state = JSON_STRING;
+            return true;
+        }
+        // Only flat objects: numbers, true, false and null as text
+        if (c == '{' || c == '[' || c == ',' || c == '}')
+        {
+            return false;
+        }
+        append(parser, c);
+        parser->state = JSON_BARE;
+        return true;
+    case JSON_BARE:
+        if (c == ',' || c == '}' || is_space(c))
+        {
+            emit(parser);
+            parser->state = JSON_COMMA_OR_END;
+            return is_space(c) || feed_json(parser, c);
+        }
+        append(parser, c);
+        return true;
+    case JSON_COMMA_OR_END:
+        if (is_space(c))
+            return true;
+        if (c == ',')
+        {
+            parser->state = JSON_KEY_START;
+            return true;
+        }
+        parser->state = JSON_DONE;
+        return c == '}';
+    case JSON_DONE:
+        return is_space(c);
+    }
+    return false;
+}
+
+bool form_parser_feed(form_parser_t *parser, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && !parser->error; i++)
+    {
+        bool ok = parser->format == FORM_PARSER_JSON ? feed_json(parser, data[i]) : feed_urlencoded(parser, data[i]);
+        parser->error = !ok;
+    }
+    return !parser->error;
+}
+
+bool form_parser_finish(form_parser_t *parser)
+{
+    if (parser->error)
+    {
+        return false;
+    }
+
+    if (parser->format == FORM_PARSER_JSON)
+    {
+        return parser->state == JSON_DONE;
+    }
+
+    if (parser->state != URL_TEXT)
+    {
+        return false;
+    }
+    if (parser->keyLen > 0 || parser->inValue)
+    {
+        emit(parser);
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef FORM_PARSER_H
+#define FORM_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Incremental parser for url-encoded forms and flat JSON objects of string/number fields.
+// Request bodies are fed in chunks as they arrive so nothing is buffered whole.
+
+#define FORM_PARSER_MAX_KEY 24
+#define FORM_PARSER_MAX_VALUE 128
+
+// Called once per field. truncated is set when the value did not fit FORM_PARSER_MAX_VALUE.
+typedef void (*form_field_cb_t)(void *ctx, const char *key, const char *value, bool truncated);
+
+typedef enum
+{
+    FORM_PARSER_URLENCODED,
+    FORM_PARSER_JSON,
+} form_parser_format_t;
+
+typedef struct
+{
+    form_parser_format_t format;
+    form_field_cb_t on_field;
+    void *ctx;
+    int state;
+    int returnState; // String state to resume after a JSON escape
+    bool inValue;
+    bool truncated;
+    bool error;
+    char escape[4];
+    int escapeLen;
+    char key[FORM_PARSER_MAX_KEY];
+    size_t keyLen;
+    char value[FORM_PARSER_MAX_VALUE];
+    size_t valueLen;
+} form_parser_t;
+
+void form_parser_init(form_parser_t *parser, form_parser_format_t format, form_field_cb_t on_field, void *ctx);
+// Returns false once the input is malformed
+bool form_parser_feed(form_parser_t *parser, const char *data, size_t len);
+// Flushes the last field. Returns false if the input was malformed or incomplete.
+bool form_parser_finish(form_parser_t *parser);
+
+#endif // FORM_PARSER_H
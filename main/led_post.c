@@ -0,0 +1,105 @@
+#include "led_post.h"
+#include <math.h>
+#include <stdbool.h>
+
+// Gamma curve and the combined gamma * brightness table used per channel
+static uint8_t gamma_lut[256];
+static uint8_t channel_lut[256];
+static uint8_t brightness = 255;
+static uint32_t budget_ma = 0;
+
+static void rebuild_channel_lut(void)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        channel_lut[i] = (gamma_lut[i] * brightness + 127) / 255;
+    }
+}
+
+void led_post_init(float gamma)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        gamma_lut[i] = (uint8_t)(powf(i / 255.0f, gamma) * 255.0f + 0.5f);
+    }
+    rebuild_channel_lut();
+}
+
+void led_post_set_brightness(uint8_t value)
+{
+    if (value == brightness)
+    {
+        return;
+    }
+    brightness = value;
+    rebuild_channel_lut();
+}
+
+uint8_t led_post_get_brightness(void)
+{
+    return brightness;
+}
+
+// 0 disables the limiter
+void led_post_set_budget(uint32_t value)
+{
+    budget_ma = value;
+}
+
+uint8_t led_post_scheduled_brightness(const led_post_schedule_t *schedule, int hour)
+{
+    bool night;
+    if (schedule->night_start_hour == schedule->night_end_hour)
+    {
+        night = false;
+    }
+    else if (schedule->night_start_hour < schedule->night_end_hour)
+    {
+        night = hour >= schedule->night_start_hour && hour < schedule->night_end_hour;
+    }
+    else
+    {
+        // Window wraps past midnight, e.g. 22 -> 7
+        night = hour >= schedule->night_start_hour || hour < schedule->night_end_hour;
+    }
+    return night ? schedule->night_brightness : schedule->day_brightness;
+}
+
+uint32_t led_post_apply(const uint32_t *in, uint32_t *out, size_t count)
+{
+    // Pass 1: gamma and brightness through the table, summing channel levels
+    uint32_t level_sum = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t c = in[i];
+        uint32_t c0 = channel_lut[c & 0xFF];
+        uint32_t c1 = channel_lut[(c >> 8) & 0xFF];
+        uint32_t c2 = channel_lut[(c >> 16) & 0xFF];
+        level_sum += c0 + c1 + c2;
+        out[i] = (c2 << 16) | (c1 << 8) | c0;
+    }
+
+    uint32_t idle_ma = count * LED_POST_IDLE_MA_PER_LED;
+    uint32_t drive_ma = level_sum * LED_POST_MA_PER_CHANNEL / 255;
+    // A dark frame has nothing to scale, even when the budget is below the idle draw
+    if (budget_ma == 0 || level_sum == 0 || idle_ma + drive_ma <= budget_ma)
+    {
+        return idle_ma + drive_ma;
+    }
+
+    // Pass 2: scale the whole frame so the driven channels fit what is left of the budget
+    uint32_t available_ma = budget_ma > idle_ma ? budget_ma - idle_ma : 0;
+    uint32_t scale = (available_ma * 255 * 256) / (level_sum * LED_POST_MA_PER_CHANNEL); // Q8, < 256
+    level_sum = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t c = out[i];
+        uint32_t c0 = ((c & 0xFF) * scale) >> 8;
+        uint32_t c1 = (((c >> 8) & 0xFF) * scale) >> 8;
+        uint32_t c2 = (((c >> 16) & 0xFF) * scale) >> 8;
+        level_sum += c0 + c1 + c2;
+        out[i] = (c2 << 16) | (c1 << 8) | c0;
+    }
+
+    return idle_ma + level_sum * LED_POST_MA_PER_CHANNEL / 255;
+}
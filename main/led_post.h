@@ -0,0 +1,32 @@
+#ifndef LED_POST_H
+#define LED_POST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Per-frame post-processing applied just before pixels are pushed to the strip.
+// Plain C with no ESP-IDF dependencies so it can be benchmarked on the host.
+
+// Typical WS2812 draw: ~20mA per channel at full drive, ~1mA quiescent per LED
+#define LED_POST_MA_PER_CHANNEL 20
+#define LED_POST_IDLE_MA_PER_LED 1
+
+typedef struct
+{
+    uint8_t day_brightness;
+    uint8_t night_brightness;
+    uint8_t night_start_hour; // Local hour (0-23) night brightness begins
+    uint8_t night_end_hour;   // Local hour (0-23) day brightness resumes
+} led_post_schedule_t;
+
+void led_post_init(float gamma);
+void led_post_set_brightness(uint8_t brightness);
+uint8_t led_post_get_brightness(void);
+void led_post_set_budget(uint32_t budget_ma);
+uint8_t led_post_scheduled_brightness(const led_post_schedule_t *schedule, int hour);
+
+// Gamma correct, scale by brightness and limit to the current budget.
+// Returns the estimated draw in mA of the output frame.
+uint32_t led_post_apply(const uint32_t *in, uint32_t *out, size_t count);
+
+#endif // LED_POST_H
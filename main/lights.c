@@ -1,39 +1,63 @@
 #include "lights.h"
 #include "esp_log.h"
-#include "cJSON.h"
 #include "driver/gpio.h"
 #include "esp_event.h"
 #include "freertos/task.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
 #include <string.h>
 #include "neopixel.h"
 #include "esp_timer.h"
+#include "led_post.h"
+#include "effect_rules.h"
+#include "config_manager.h"
+#include <ctype.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
 
 static const char *TAG = "LIGHTS";
 
-static QueueHandle_t lights_queue = NULL;
-
 static void lights_task(void *pvParameters);
-static void neopixel_clear();
-static void neopixel_price_bar_fall();
-static void neopixel_price_bar_rise();
-static void neopixel_police(int iterations);
-static void neopixel_flash(int start, int end, int iterations, uint32_t colorOn, uint32_t colorOff);
-static void neopixel_on(int start, int end, uint32_t colorOn);
-static void neopixel_bar(int barSize, int start, int end, uint32_t colorOn, uint32_t colorOff, int delay);
+static bool lights_start_effect(const blink_event_t *event);
+static void lights_render(int64_t now);
+static void lights_show(void);
+static void lights_update_brightness(void);
+static void effect_clear();
+static void effect_hold(int durationMs);
+static void effect_price_bar_fall(uint32_t color);
+static void effect_price_bar_rise(uint32_t color);
+static void effect_police(int iterations);
+static void effect_flash(int start, int end, int iterations, uint32_t colorOn, uint32_t colorOff);
+static void effect_on(int start, int end, uint32_t colorOn);
+static void effect_bar(int barSize, int start, int end, uint32_t colorOn, uint32_t colorOff, int delay);
+static void effect_scale(uint32_t durationMs);
 
 // https://github.com/zorxx/neopixel/tree/main
 static tNeopixelContext neopixel;
 static uint32_t refreshRate;
 static uint32_t taskDelay;
+static uint32_t frameMs;
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
-#define PIXEL_COUNT 75
+#define PIXEL_COUNT LIGHTS_PIXEL_COUNT
 #define NEOPIXEL_PIN GPIO_NUM_12
 
-// static const uint32_t COLOR_BITCOIN_ORANGE = NP_RGB(150, 90, 0);
-static const uint32_t COLOR_BITCOIN_YELLOW = NP_RGB(130, 96, 0);
+// Render loop runs pinned to the app core, above the network tasks on the protocol core
+#define LIGHTS_TASK_PRIORITY 10
+#define LIGHTS_TASK_CORE (portNUM_PROCESSORS - 1)
+#define LIGHTS_TASK_STACK 4096
+
+// Post-processing applied to every frame, see led_post.h
+#define LIGHTS_GAMMA 2.2f
+#define LIGHTS_SCHEDULE_CHECK_US (60 * 1000000LL)
+
+// Colours as drawn by the effects and as last sent to the strip
+static uint32_t frame[PIXEL_COUNT];
+static uint32_t frame_out[PIXEL_COUNT];
+static int64_t lastScheduleCheck = 0;
+
+// Defaults for rules that leave the colour unset
 static const uint32_t COLOR_WHITE = NP_RGB(120, 120, 120);
 static const uint32_t COLOR_RED = NP_RGB(214, 17, 37);
 static const uint32_t COLOR_GREEN = NP_RGB(18, 125, 4);
@@ -43,18 +67,78 @@ static const uint32_t COLOR_OFF = NP_RGB(0, 0, 0);
 // Last price received
 static int64_t lastPrice = 0;
 
-// LED positions for each the 6 segments
-static const int SEGMENT[][2] = {
-    {0, 13},
-    {13, 24},
-    {24, 36},
-    {37, 50},
-    {50, 60},
-    {61, 74},
+// Brightness, power budget and segment layout. Only the render task reads settings,
+// other tasks hand new values over through pendingSettings.
+static lights_settings_t settings;
+static lights_settings_t pendingSettings;
+static atomic_bool settingsChanged;
+static portMUX_TYPE settingsLock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const EVENT_TYPE_NAMES[LIGHTS_EVENT_TYPE_COUNT] = {
+    [LIGHTS_EVENT_UNKNOWN] = "",
+    [LIGHTS_EVENT_MINING_SUBMIT] = "mining.submit",
+    [LIGHTS_EVENT_MINING_NOTIFY] = "mining.notify",
+    [LIGHTS_EVENT_TX] = "tx",
+    [LIGHTS_EVENT_PRICE] = "price",
+    [LIGHTS_EVENT_BLOCK] = "block",
+    [LIGHTS_EVENT_ASIC_RESULT] = "asic_result",
 };
 
+// Single-producer/single-consumer ring between the websocket task and the render task.
+// head is only written by the producer and tail only by the consumer.
+#define LIGHTS_RING_SIZE 128 // Must be a power of two
+static blink_event_t ring[LIGHTS_RING_SIZE];
+static atomic_uint ringHead;
+static atomic_uint ringTail;
+
+// An effect is a short program of time based steps drawn into the frame each tick
+typedef enum
+{
+    STEP_FILL,      // Light pixels start..end inclusive one per step
+    STEP_FLASH,     // Alternate start..end between two colours, then clear
+    STEP_BAR,       // Move a bar of count pixels from start to end
+    STEP_SWEEP,     // Grow two lines away from start and end in opposite directions
+    STEP_ALTERNATE, // Alternate colours on every other pixel of the whole strip
+    STEP_HOLD,      // Leave the frame as is
+    STEP_CLEAR,     // Turn the whole strip off
+} step_kind_t;
+
+typedef struct
+{
+    uint8_t kind;
+    int16_t start;
+    int16_t end;
+    int16_t count;
+    int16_t dir;
+    uint16_t stepMs;
+    uint32_t colorOn;
+    uint32_t colorOff;
+} effect_step_t;
+
+#define EFFECT_MAX_STEPS 6
+static effect_step_t steps[EFFECT_MAX_STEPS];
+static int stepCount = 0;
+static int activeStep = 0;
+static int64_t stepStartUs = 0;
+
+static TaskHandle_t renderTask = NULL;
+static lights_stats_t stats;
+static atomic_uint droppedEvents;
+static atomic_uint queueMax;
+
 void lights_init(void)
 {
+    device_config_t config;
+    config_manager_load(&config);
+    settings = config.lights;
+    setenv("TZ", settings.timezone, 1);
+    tzset();
+
+    led_post_init(LIGHTS_GAMMA);
+    led_post_set_budget(settings.power_budget_ma);
+    lights_update_brightness();
+    effect_rules_init();
+
     // Initialize neopixel
     neopixel = neopixel_Init(PIXEL_COUNT, NEOPIXEL_PIN);
     if (NULL == neopixel)
@@ -64,205 +148,529 @@ void lights_init(void)
 
     refreshRate = neopixel_GetRefreshRate(neopixel);
     taskDelay = MAX(1, pdMS_TO_TICKS(1000UL / refreshRate));
-    neopixel_clear();
+    frameMs = pdTICKS_TO_MS(taskDelay);
+    // Pixels are 24 bit, so no pixel matches and the first show clears the whole strip
+    // even when a software restart left LEDs lit
+    memset(frame_out, 0xFF, sizeof(frame_out));
+    lights_show();
     vTaskDelay(taskDelay);
 
-    lights_queue = xQueueCreate(100, sizeof(blink_event_t));
-    xTaskCreate(lights_task, "led_task", 4096, NULL, 5, NULL);
+    xTaskCreatePinnedToCore(lights_task, "led_task", LIGHTS_TASK_STACK, NULL,
+                            LIGHTS_TASK_PRIORITY, &renderTask, LIGHTS_TASK_CORE);
 }
 
-void queue_lights_event(const blink_event_t event)
+bool lights_settings_valid(const lights_settings_t *candidate)
 {
-    if (lights_queue == NULL)
+    if (candidate->brightness.night_start_hour > 23 || candidate->brightness.night_end_hour > 23)
+    {
+        return false;
+    }
+    if (candidate->power_budget_ma != 0 && candidate->power_budget_ma < LIGHTS_MIN_POWER_BUDGET_MA)
+    {
+        return false;
+    }
+    size_t timezoneLength = strnlen(candidate->timezone, LIGHTS_TIMEZONE_LENGTH);
+    if (timezoneLength == 0 || timezoneLength == LIGHTS_TIMEZONE_LENGTH)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < timezoneLength; i++)
+    {
+        if (!isprint((unsigned char)candidate->timezone[i]))
+        {
+            return false;
+        }
+    }
+    for (int i = 0; i < LIGHTS_SEGMENT_COUNT; i++)
+    {
+        if (candidate->segments[i][0] >= candidate->segments[i][1] || candidate->segments[i][1] >= PIXEL_COUNT)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void lights_apply_settings(const lights_settings_t *newSettings)
+{
+    portENTER_CRITICAL(&settingsLock);
+    pendingSettings = *newSettings;
+    portEXIT_CRITICAL(&settingsLock);
+    atomic_store(&settingsChanged, true);
+}
+
+// Called from the render task between frames
+static void lights_update_settings(void)
+{
+    if (!atomic_exchange(&settingsChanged, false))
     {
-        ESP_LOGE(TAG, "Event queue not initialized");
         return;
     }
 
-    xQueueSend(lights_queue, &event, 10 / portTICK_PERIOD_MS);
+    portENTER_CRITICAL(&settingsLock);
+    settings = pendingSettings;
+    portEXIT_CRITICAL(&settingsLock);
+
+    setenv("TZ", settings.timezone, 1);
+    tzset();
+    led_post_set_budget(settings.power_budget_ma);
+    lights_update_brightness();
 }
 
-// lights_queue worker. Runs effects based on event type
+lights_event_type_t lights_event_type_from_string(const char *type)
+{
+    for (int i = 1; i < LIGHTS_EVENT_TYPE_COUNT; i++)
+    {
+        if (strcmp(type, EVENT_TYPE_NAMES[i]) == 0)
+        {
+            return i;
+        }
+    }
+    return LIGHTS_EVENT_UNKNOWN;
+}
+
+bool queue_lights_event(const blink_event_t *event)
+{
+    if (renderTask == NULL)
+    {
+        ESP_LOGE(TAG, "Event queue not initialized");
+        return false;
+    }
+
+    unsigned head = atomic_load_explicit(&ringHead, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ringTail, memory_order_acquire);
+    if (head - tail >= LIGHTS_RING_SIZE)
+    {
+        atomic_fetch_add_explicit(&droppedEvents, 1, memory_order_relaxed);
+        return false;
+    }
+
+    blink_event_t *slot = &ring[head & (LIGHTS_RING_SIZE - 1)];
+    *slot = *event;
+    slot->queued_us = esp_timer_get_time();
+    atomic_store_explicit(&ringHead, head + 1, memory_order_release);
+
+    unsigned depth = head + 1 - tail;
+    if (depth > atomic_load_explicit(&queueMax, memory_order_relaxed))
+    {
+        atomic_store_explicit(&queueMax, depth, memory_order_relaxed);
+    }
+    return true;
+}
+
+static bool ring_pop(blink_event_t *event)
+{
+    unsigned tail = atomic_load_explicit(&ringTail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ringHead, memory_order_acquire);
+    if (head == tail)
+    {
+        return false;
+    }
+
+    *event = ring[tail & (LIGHTS_RING_SIZE - 1)];
+    atomic_store_explicit(&ringTail, tail + 1, memory_order_release);
+    return true;
+}
+
+void lights_get_stats(lights_stats_t *out)
+{
+    *out = stats;
+    out->dropped = atomic_load(&droppedEvents);
+    out->queue_depth = atomic_load(&ringHead) - atomic_load(&ringTail);
+    out->queue_max = atomic_load(&queueMax);
+}
+
+// Fixed rate render loop. Starts the next queued effect when the current one finishes.
 static void lights_task(void *pvParameters)
 {
-    blink_event_t event;
-    int64_t value = 0;
-    const int64_t SATOSHIS_PER_BITCOIN = 100000000; // Define constant
+    TickType_t lastWake = xTaskGetTickCount();
     while (1)
     {
-        if (xQueueReceive(lights_queue, &event, 800 / portTICK_PERIOD_MS) == pdTRUE)
+        vTaskDelayUntil(&lastWake, taskDelay);
+        lights_update_settings();
+
+        int64_t now = esp_timer_get_time();
+        blink_event_t event;
+        while (activeStep >= stepCount && ring_pop(&event))
         {
-            int segment = event.segment - 1;
-            if (strcmp(event.type, "mining.submit") == 0)
-            {
-                neopixel_on(SEGMENT[segment][0], SEGMENT[segment][1], COLOR_BITCOIN_YELLOW);
-                neopixel_flash(SEGMENT[segment][0], SEGMENT[segment][1], 1, COLOR_BITCOIN_YELLOW, NP_RGB(0, 0, 0));
-            }
-            else if (strcmp(event.type, "mining.notify") == 0)
-            {
-                neopixel_flash(SEGMENT[segment][0], SEGMENT[segment][1], 5, NP_RGB(227, 218, 52), COLOR_OFF);
-            }
-            else if (strcmp(event.type, "tx") == 0)
+            if (lights_start_effect(&event))
             {
-                neopixel_bar(10, 1, PIXEL_COUNT, COLOR_GREEN, COLOR_OFF, 0);
-                value = event.value / SATOSHIS_PER_BITCOIN;
-                ESP_LOGI(TAG, "Transaction value: %lld BTC", value);
-                neopixel_flash(0, PIXEL_COUNT, 2, COLOR_GREEN, COLOR_OFF);
-            }
-            else if (strcmp(event.type, "price") == 0)
-            {
-                if (lastPrice > event.value)
-                {
-                    neopixel_price_bar_fall();
-                }
-                else
-                {
-                    neopixel_price_bar_rise();
-                }
-                lastPrice = event.value;
-            }
-            else if (strcmp(event.type, "block") == 0)
-            {
-                neopixel_bar(10, 0, PIXEL_COUNT, COLOR_WHITE, COLOR_OFF, 0);
-                neopixel_flash(0, PIXEL_COUNT, 10, COLOR_WHITE, COLOR_OFF);
+                stepStartUs = now;
+                // The websocket task can queue an event after now was read
+                stats.latency_us = MAX(now - event.queued_us, 0);
+                stats.max_latency_us = MAX(stats.max_latency_us, stats.latency_us);
             }
         }
+
+        lights_render(now);
+        lights_show();
+
+        uint32_t renderUs = esp_timer_get_time() - now;
+        stats.frames++;
+        stats.max_render_us = MAX(stats.max_render_us, renderUs);
+        if (renderUs > frameMs * 1000)
+        {
+            stats.overruns++;
+        }
     }
 }
 
-static void neopixel_clear()
+static uint32_t rule_color(const effect_rule_t *rule, uint32_t defaultColor)
 {
-    tNeopixel pixel[PIXEL_COUNT];
-    for (int i = 0; i < PIXEL_COUNT; i++)
+    if (rule->color == 0)
     {
-        pixel[i] = (tNeopixel){i, NP_RGB(0, 0, 0)};
+        return defaultColor;
     }
-    neopixel_SetPixel(neopixel, pixel, ARRAY_SIZE(pixel));
-    vTaskDelay(taskDelay);
+    return NP_RGB((rule->color >> 16) & 0xFF, (rule->color >> 8) & 0xFF, rule->color & 0xFF);
+}
+
+static int rule_repeat(const effect_rule_t *rule, int defaultRepeat)
+{
+    return rule->repeat ? rule->repeat : defaultRepeat;
 }
 
-static void neopixel_flash(int start, int end, int iterations, uint32_t colorOn, uint32_t colorOff)
+// Builds the effect program for an event from the first matching rule.
+// Returns false when no rule matched or the effect has nothing to draw.
+static bool lights_start_effect(const blink_event_t *event)
 {
-    int length = end - start;
-    tNeopixel pixelsOn[length];
-    tNeopixel pixelsOff[length];
-    tNeopixel pixelsClear[length];
+    const int64_t SATOSHIS_PER_BITCOIN = 100000000;
+    int segment = event->segment - 1;
+    bool validSegment = segment >= 0 && segment < LIGHTS_SEGMENT_COUNT;
+    int64_t previousPrice = lastPrice;
+    effect_rule_t rule;
+
+    stepCount = 0;
+    activeStep = 0;
+
+    if (event->type == LIGHTS_EVENT_PRICE)
+    {
+        lastPrice = event->value;
+    }
+    else if (event->type == LIGHTS_EVENT_TX)
+    {
+        ESP_LOGI(TAG, "Transaction value: %lld BTC", event->value / SATOSHIS_PER_BITCOIN);
+    }
 
-    for (int i = 0; i < length; i++)
+    if (!effect_rules_match(event, &rule))
     {
-        pixelsOn[i] = (tNeopixel){start + i, colorOn};
-        pixelsOff[i] = (tNeopixel){start + i, colorOff};
-        pixelsClear[i] = (tNeopixel){start + i, NP_RGB(0, 0, 0)};
+        return false;
     }
 
-    for (int i = 0; i < iterations; i++)
+    switch (rule.effect)
     {
-        neopixel_SetPixel(neopixel, pixelsOn, ARRAY_SIZE(pixelsOn));
-        vTaskDelay(taskDelay + 50 / portTICK_PERIOD_MS);
+    case EFFECT_SEGMENT_FILL:
+        if (validSegment)
+        {
+            uint32_t color = rule_color(&rule, COLOR_WHITE);
+            effect_on(settings.segments[segment][0], settings.segments[segment][1], color);
+            effect_flash(settings.segments[segment][0], settings.segments[segment][1], rule_repeat(&rule, 1), color, COLOR_OFF);
+        }
+        break;
+    case EFFECT_SEGMENT_FLASH:
+        if (validSegment)
+        {
+            effect_flash(settings.segments[segment][0], settings.segments[segment][1], rule_repeat(&rule, 5),
+                         rule_color(&rule, COLOR_WHITE), COLOR_OFF);
+        }
+        break;
+    case EFFECT_BAR_FLASH:
+        effect_bar(10, 0, PIXEL_COUNT, rule_color(&rule, COLOR_WHITE), COLOR_OFF, 0);
+        effect_flash(0, PIXEL_COUNT, rule_repeat(&rule, 2), rule_color(&rule, COLOR_WHITE), COLOR_OFF);
+        break;
+    case EFFECT_PRICE:
+        if (previousPrice > event->value)
+        {
+            effect_price_bar_fall(rule_color(&rule, COLOR_RED));
+        }
+        else
+        {
+            effect_price_bar_rise(rule_color(&rule, COLOR_GREEN));
+        }
+        break;
+    case EFFECT_POLICE:
+        effect_police(rule_repeat(&rule, 5));
+        break;
+    }
 
-        neopixel_SetPixel(neopixel, pixelsOff, ARRAY_SIZE(pixelsOff));
-        vTaskDelay(taskDelay + 50 / portTICK_PERIOD_MS);
+    if (rule.duration_ms > 0)
+    {
+        effect_scale(rule.duration_ms);
     }
 
-    neopixel_SetPixel(neopixel, pixelsClear, ARRAY_SIZE(pixelsClear));
+    if (stepCount > 0)
+    {
+        stats.events++;
+    }
+    return stepCount > 0;
 }
 
-static void neopixel_on(int start, int end, uint32_t colorOn)
+static void fill_range(int start, int end, uint32_t color)
 {
-    for (int i = start; i < end + 1; i++)
+    for (int i = MAX(start, 0); i < MIN(end, PIXEL_COUNT); i++)
     {
-        tNeopixel pixel[] = {
-            {i, colorOn},
-        };
-        neopixel_SetPixel(neopixel, pixel, ARRAY_SIZE(pixel));
-        vTaskDelay(taskDelay);
+        frame[i] = color;
     }
-    vTaskDelay(300 / portTICK_PERIOD_MS);
-    neopixel_clear();
 }
 
-static void neopixel_price_bar_fall()
+static void set_pixel(int index, uint32_t color)
 {
-    int secondPixelIndex = 29;
-    for (int i = 81; i > 65; i--)
+    if (index >= 0 && index < PIXEL_COUNT)
     {
-        tNeopixel pixel[] = {
-            {i % 74, COLOR_RED},
-            {secondPixelIndex++, COLOR_RED},
-        };
-        neopixel_SetPixel(neopixel, pixel, ARRAY_SIZE(pixel));
-        vTaskDelay(200 / portTICK_PERIOD_MS);
+        frame[index] = color;
     }
-    neopixel_clear();
 }
 
-static void neopixel_price_bar_rise()
+// Draws a step elapsedMs into it. Returns true once the step has finished.
+static bool step_render(const effect_step_t *step, uint32_t elapsedMs)
 {
-    int secondPixelIndex = 44;
-    for (int i = 66; i < 82; i++)
+    int n = elapsedMs / MAX(step->stepMs, 1);
+
+    switch (step->kind)
+    {
+    case STEP_FILL:
     {
-        tNeopixel pixel[] = {
-            {i % 74, COLOR_GREEN},
-            {secondPixelIndex--, COLOR_GREEN},
-        };
-        neopixel_SetPixel(neopixel, pixel, ARRAY_SIZE(pixel));
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+        int length = step->end - step->start + 1;
+        fill_range(step->start, step->start + MIN(n + 1, length), step->colorOn);
+        return n >= length;
+    }
+    case STEP_FLASH:
+        if (n >= 2 * step->count)
+        {
+            fill_range(step->start, step->end, COLOR_OFF);
+            return true;
+        }
+        fill_range(step->start, step->end, (n % 2 == 0) ? step->colorOn : step->colorOff);
+        return false;
+    case STEP_BAR:
+    {
+        int total = step->end - step->start + step->count;
+        int drawn = step->start + MIN(n + 1, total);
+        for (int i = step->start; i < MIN(drawn, step->end); i++)
+        {
+            set_pixel(i, i >= drawn - step->count ? step->colorOn : step->colorOff);
+        }
+        return n >= total;
+    }
+    case STEP_SWEEP:
+    {
+        const int wrap = PIXEL_COUNT - 1;
+        for (int k = 0; k < MIN(n + 1, step->count); k++)
+        {
+            set_pixel(((step->start + step->dir * k) % wrap + wrap) % wrap, step->colorOn);
+            set_pixel(step->end - step->dir * k, step->colorOn);
+        }
+        return n >= step->count;
+    }
+    case STEP_ALTERNATE:
+        if (n < 2 * step->count)
+        {
+            for (int i = 0; i < PIXEL_COUNT; i++)
+            {
+                frame[i] = ((i + n) % 2 == 0) ? step->colorOn : step->colorOff;
+            }
+        }
+        return n >= 2 * step->count;
+    case STEP_HOLD:
+        return elapsedMs >= step->stepMs;
+    case STEP_CLEAR:
+    default:
+        fill_range(0, PIXEL_COUNT, COLOR_OFF);
+        return true;
     }
-    neopixel_clear();
 }
 
-static void neopixel_police(int iterations)
+static void lights_render(int64_t now)
 {
-    tNeopixel pixel[PIXEL_COUNT];
-    uint32_t colors[] = {COLOR_RED, COLOR_BLUE};
-    for (int j = 0; j < iterations; j++)
+    while (activeStep < stepCount)
     {
-        for (int i = 0; i < PIXEL_COUNT; i++)
+        uint32_t elapsedMs = (now - stepStartUs) / 1000;
+        if (!step_render(&steps[activeStep], elapsedMs))
         {
-            pixel[i] = (tNeopixel){i, colors[i % 2]};
+            return;
         }
-        neopixel_SetPixel(neopixel, pixel, ARRAY_SIZE(pixel));
-        vTaskDelay(10 + taskDelay);
+        activeStep++;
+        stepStartUs = now;
+    }
+}
+
+// Follow the night schedule once the clock has been set by SNTP
+static void lights_update_brightness(void)
+{
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    if (local.tm_year < (2024 - 1900))
+    {
+        led_post_set_brightness(settings.brightness.day_brightness);
+        return;
+    }
+    led_post_set_brightness(led_post_scheduled_brightness(&settings.brightness, local.tm_hour));
+}
 
-        for (int i = 0; i < PIXEL_COUNT; i++)
+// Post-process the frame and send only the pixels that changed
+static void lights_show(void)
+{
+    static uint32_t processed[PIXEL_COUNT];
+    static tNeopixel changed[PIXEL_COUNT];
+
+    int64_t now = esp_timer_get_time();
+    if (now - lastScheduleCheck > LIGHTS_SCHEDULE_CHECK_US)
+    {
+        lastScheduleCheck = now;
+        lights_update_brightness();
+    }
+
+    led_post_apply(frame, processed, PIXEL_COUNT);
+
+    size_t changedCount = 0;
+    for (int i = 0; i < PIXEL_COUNT; i++)
+    {
+        if (processed[i] != frame_out[i])
         {
-            pixel[i] = (tNeopixel){i, colors[(i + 1) % 2]};
+            frame_out[i] = processed[i];
+            changed[changedCount++] = (tNeopixel){i, processed[i]};
         }
-        neopixel_SetPixel(neopixel, pixel, ARRAY_SIZE(pixel));
-        vTaskDelay(10 + taskDelay);
     }
-    neopixel_clear();
+
+    if (changedCount > 0)
+    {
+        neopixel_SetPixel(neopixel, changed, changedCount);
+    }
+}
+
+static void effect_add(effect_step_t step)
+{
+    if (stepCount < EFFECT_MAX_STEPS)
+    {
+        steps[stepCount++] = step;
+    }
+}
+
+static void effect_clear()
+{
+    effect_add((effect_step_t){.kind = STEP_CLEAR});
+}
+
+static void effect_hold(int durationMs)
+{
+    effect_add((effect_step_t){.kind = STEP_HOLD, .stepMs = durationMs});
+}
+
+static void effect_flash(int start, int end, int iterations, uint32_t colorOn, uint32_t colorOff)
+{
+    effect_add((effect_step_t){
+        .kind = STEP_FLASH,
+        .start = start,
+        .end = end,
+        .count = iterations,
+        .stepMs = frameMs + 50,
+        .colorOn = colorOn,
+        .colorOff = colorOff,
+    });
+}
+
+static void effect_on(int start, int end, uint32_t colorOn)
+{
+    effect_add((effect_step_t){
+        .kind = STEP_FILL,
+        .start = start,
+        .end = end,
+        .stepMs = frameMs,
+        .colorOn = colorOn,
+    });
+    effect_hold(300);
+    effect_clear();
+}
+
+static void effect_price_bar_fall(uint32_t color)
+{
+    effect_add((effect_step_t){
+        .kind = STEP_SWEEP,
+        .start = 81,
+        .end = 29,
+        .count = 16,
+        .dir = -1,
+        .stepMs = 200,
+        .colorOn = color,
+    });
+    effect_clear();
+}
+
+static void effect_price_bar_rise(uint32_t color)
+{
+    effect_add((effect_step_t){
+        .kind = STEP_SWEEP,
+        .start = 66,
+        .end = 44,
+        .count = 16,
+        .dir = 1,
+        .stepMs = 100,
+        .colorOn = color,
+    });
+    effect_clear();
+}
+
+static void effect_police(int iterations)
+{
+    effect_add((effect_step_t){
+        .kind = STEP_ALTERNATE,
+        .count = iterations,
+        .stepMs = pdTICKS_TO_MS(10) + frameMs,
+        .colorOn = COLOR_RED,
+        .colorOff = COLOR_BLUE,
+    });
+    effect_clear();
+}
+
+static void effect_bar(int barSize, int start, int end, uint32_t colorOn, uint32_t colorOff, int delay)
+{
+    effect_add((effect_step_t){
+        .kind = STEP_BAR,
+        .start = start,
+        .end = end,
+        .count = barSize,
+        .stepMs = frameMs + delay,
+        .colorOn = colorOn,
+        .colorOff = colorOff,
+    });
+}
+
+static uint32_t step_duration(const effect_step_t *step)
+{
+    switch (step->kind)
+    {
+    case STEP_FILL:
+        return (step->end - step->start + 1) * step->stepMs;
+    case STEP_FLASH:
+    case STEP_ALTERNATE:
+        return 2 * step->count * step->stepMs;
+    case STEP_BAR:
+        return (step->end - step->start + step->count) * step->stepMs;
+    case STEP_SWEEP:
+        return step->count * step->stepMs;
+    case STEP_HOLD:
+        return step->stepMs;
+    default:
+        return 0;
+    }
 }
 
-static void neopixel_bar(int barSize, int start, int end, uint32_t colorOn, uint32_t colorOff, int delay)
+// Stretch or shrink the steps so the whole effect lasts durationMs
+static void effect_scale(uint32_t durationMs)
 {
-    // Turn on the first barSize pixels
-    for (int i = start; i < start + barSize; i++)
+    uint32_t total = 0;
+    for (int i = 0; i < stepCount; i++)
     {
-        tNeopixel pixel[] = {
-            {i, colorOn},
-        };
-        neopixel_SetPixel(neopixel, pixel, ARRAY_SIZE(pixel));
-        vTaskDelay(taskDelay + delay / portTICK_PERIOD_MS);
+        total += step_duration(&steps[i]);
     }
-    // Move the bar
-    for (int i = start + barSize; i < end; i++)
+    if (total == 0)
     {
-        tNeopixel pixel[] =
-            {
-                {(i - barSize), colorOff},
-                {i, colorOn},
-            };
-        neopixel_SetPixel(neopixel, pixel, ARRAY_SIZE(pixel));
-        vTaskDelay(taskDelay + delay / portTICK_PERIOD_MS);
-    }
-    // Turn off the last barSize pixels
-    for (int i = end - barSize; i < end; i++)
-    {
-        tNeopixel pixel[] = {
-            {i, colorOff},
-        };
-        neopixel_SetPixel(neopixel, pixel, ARRAY_SIZE(pixel));
-        vTaskDelay(taskDelay + delay / portTICK_PERIOD_MS);
-    }
-}
\ No newline at end of file
+        return;
+    }
+
+    for (int i = 0; i < stepCount; i++)
+    {
+        uint32_t stepMs = (uint32_t)steps[i].stepMs * durationMs / total;
+        steps[i].stepMs = MIN(MAX(stepMs, 1), UINT16_MAX);
+    }
+}
@@ -1,16 +1,65 @@
 #ifndef LIGHTS_H
 #define LIGHTS_H
 
+#include <stdbool.h>
 #include <stdint.h>
+#include "led_post.h"
+
+#define LIGHTS_PIXEL_COUNT 75
+#define LIGHTS_SEGMENT_COUNT 6
+#define LIGHTS_TIMEZONE_LENGTH 48
+// Lowest nonzero power budget, the idle draw of the whole strip
+#define LIGHTS_MIN_POWER_BUDGET_MA (LIGHTS_PIXEL_COUNT * LED_POST_IDLE_MA_PER_LED)
+
+typedef enum
+{
+    LIGHTS_EVENT_UNKNOWN = 0,
+    LIGHTS_EVENT_MINING_SUBMIT,
+    LIGHTS_EVENT_MINING_NOTIFY,
+    LIGHTS_EVENT_TX,
+    LIGHTS_EVENT_PRICE,
+    LIGHTS_EVENT_BLOCK,
+    LIGHTS_EVENT_ASIC_RESULT,
+    LIGHTS_EVENT_TYPE_COUNT
+} lights_event_type_t;
 
 typedef struct
 {
-    char type[32];
-    int segment;
+    uint8_t type; // lights_event_type_t
+    int8_t segment; // 1..LIGHTS_SEGMENT_COUNT, 0 for events not tied to a segment
     int64_t value;
+    int64_t queued_us; // Set by queue_lights_event
 } blink_event_t;
 
+typedef struct
+{
+    uint32_t frames;        // Render ticks run
+    uint32_t overruns;      // Ticks that took longer than the render period
+    uint32_t max_render_us; // Slowest render tick
+    uint32_t events;        // Events started
+    uint32_t dropped;       // Events dropped because the ring was full
+    uint32_t queue_depth;   // Events waiting in the ring
+    uint32_t queue_max;     // Highest ring depth seen
+    uint32_t latency_us;    // Queue wait of the last effect started
+    uint32_t max_latency_us;
+} lights_stats_t;
+
+// Runtime settings stored in the device config
+typedef struct
+{
+    led_post_schedule_t brightness;
+    char timezone[LIGHTS_TIMEZONE_LENGTH]; // POSIX TZ string the schedule hours are in, e.g. "CET-1CEST,M3.5.0,M10.5.0/3"
+    uint16_t power_budget_ma; // 0 disables the current limiter, otherwise at least LIGHTS_MIN_POWER_BUDGET_MA
+    uint8_t segments[LIGHTS_SEGMENT_COUNT][2]; // First and last LED of each segment
+} lights_settings_t;
+
 void lights_init(void);
-void queue_lights_event(const blink_event_t event);
+// Takes effect on the next render tick
+void lights_apply_settings(const lights_settings_t *settings);
+bool lights_settings_valid(const lights_settings_t *settings);
+lights_event_type_t lights_event_type_from_string(const char *type);
+// Single producer: only call from the websocket parsing task (websocket_init)
+bool queue_lights_event(const blink_event_t *event);
+void lights_get_stats(lights_stats_t *stats);
 
-#endif // LIGHTS_H
\ No newline at end of file
+#endif // LIGHTS_H
@@ -3,6 +3,7 @@
 #include "nvs_flash.h"
 #include "wifi_manager.h"
 #include "config_manager.h"
+#include "sys_stats.h"
 
 static const char *TAG = "BITAXE_LED";
 
@@ -12,6 +13,7 @@ void app_main(void)
     
     // Initialize configuration system
     config_manager_init();
+    sys_stats_init();
     
     // If we're not in AP mode, initialize the lights and WiFi
     if (config_manager_is_configured()) {
@@ -0,0 +1,94 @@
+#include "sys_stats.h"
+#include "lights.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <inttypes.h>
+#include <stdio.h>
+
+static const char *TAG = "SYS_STATS";
+
+#define SYS_STATS_INTERVAL_MS 60000
+#define SYS_STATS_TASK_CORE 0
+
+// Guards the task snapshot buffer shared by the logging task and the status page
+static SemaphoreHandle_t statsLock = NULL;
+
+static configRUN_TIME_COUNTER_TYPE previous_run_time(const sys_stats_sample_t *previous, UBaseType_t taskNumber)
+{
+    for (int i = 0; i < SYS_STATS_MAX_TASKS; i++)
+    {
+        if (previous->taskNumber[i] == taskNumber)
+        {
+            return previous->runTime[i];
+        }
+    }
+    return 0;
+}
+
+// CPU is a percentage of one core since the caller's previous report, so the total across tasks is 100% per core
+size_t sys_stats_format(sys_stats_sample_t *previous, char *buf, size_t len)
+{
+    static TaskStatus_t tasks[SYS_STATS_MAX_TASKS];
+    if (statsLock == NULL || xSemaphoreTake(statsLock, pdMS_TO_TICKS(1000)) != pdTRUE)
+    {
+        return snprintf(buf, len, "stats unavailable\n");
+    }
+
+    configRUN_TIME_COUNTER_TYPE totalRunTime;
+    UBaseType_t count = uxTaskGetSystemState(tasks, SYS_STATS_MAX_TASKS, &totalRunTime);
+    configRUN_TIME_COUNTER_TYPE interval = totalRunTime - previous->totalRunTime;
+    size_t used = 0;
+
+    used += snprintf(buf + used, len - used, "%-16s %4s %5s %6s\n", "task", "core", "cpu%", "stack");
+    for (UBaseType_t i = 0; i < count && used < len; i++)
+    {
+        configRUN_TIME_COUNTER_TYPE runTime = tasks[i].ulRunTimeCounter - previous_run_time(previous, tasks[i].xTaskNumber);
+        int core = tasks[i].xCoreID == tskNO_AFFINITY ? -1 : (int)tasks[i].xCoreID;
+        used += snprintf(buf + used, len - used, "%-16s %4d %5llu %6lu\n",
+                         tasks[i].pcTaskName, core,
+                         interval ? (unsigned long long)runTime * 100 / interval : 0,
+                         (unsigned long)tasks[i].usStackHighWaterMark);
+    }
+
+    for (UBaseType_t i = 0; i < SYS_STATS_MAX_TASKS; i++)
+    {
+        previous->taskNumber[i] = i < count ? tasks[i].xTaskNumber : 0;
+        previous->runTime[i] = i < count ? tasks[i].ulRunTimeCounter : 0;
+    }
+    previous->totalRunTime = totalRunTime;
+    xSemaphoreGive(statsLock);
+
+    lights_stats_t lights;
+    lights_get_stats(&lights);
+    if (used < len)
+    {
+        used += snprintf(buf + used, len - used,
+                         "lights: frames %" PRIu32 " overruns %" PRIu32 " max %" PRIu32 "us events %" PRIu32
+                         " dropped %" PRIu32 " queue %" PRIu32 "/%" PRIu32 " latency %" PRIu32 "/%" PRIu32 "us\n",
+                         lights.frames, lights.overruns, lights.max_render_us, lights.events,
+                         lights.dropped, lights.queue_depth, lights.queue_max,
+                         lights.latency_us, lights.max_latency_us);
+    }
+
+    return used < len ? used : len - 1;
+}
+
+static void sys_stats_task(void *pvParameters)
+{
+    static char buf[1536];
+    static sys_stats_sample_t previous;
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(SYS_STATS_INTERVAL_MS));
+        sys_stats_format(&previous, buf, sizeof(buf));
+        ESP_LOGI(TAG, "\n%s", buf);
+    }
+}
+
+void sys_stats_init(void)
+{
+    statsLock = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(sys_stats_task, "sys_stats", 3072, NULL, 1, NULL, SYS_STATS_TASK_CORE);
+}
@@ -0,0 +1,22 @@
+#ifndef SYS_STATS_H
+#define SYS_STATS_H
+
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+
+#define SYS_STATS_MAX_TASKS 24
+
+// Run time counters from a caller's previous report, so each caller gets CPU use for its own interval
+typedef struct
+{
+    UBaseType_t taskNumber[SYS_STATS_MAX_TASKS];
+    configRUN_TIME_COUNTER_TYPE runTime[SYS_STATS_MAX_TASKS];
+    configRUN_TIME_COUNTER_TYPE totalRunTime;
+} sys_stats_sample_t;
+
+// Periodically logs per-task CPU use and stack high-water marks along with the lights stats
+void sys_stats_init(void);
+// Writes the task and lights stats as text and updates previous, returns the length written
+size_t sys_stats_format(sys_stats_sample_t *previous, char *buf, size_t len);
+
+#endif // SYS_STATS_H
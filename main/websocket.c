@@ -1,16 +1,94 @@
 #include "esp_log.h"
+#include "websocket.h"
 #include "lights.h"
 #include "config_manager.h"
+#include "effect_rules.h"
 #include <cJSON.h>
 #include "esp_event_base.h"
 #include "esp_http_client.h"
 #include "freertos/task.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/message_buffer.h"
 #include "esp_websocket_client.h"
+#include <stdio.h>
 #include <string.h>
 
 static const char *TAG = "WEBSOCKET";
 
+static websocket_stats_t stats;
+
+// Frames larger than the client buffer arrive in chunks and are reassembled here.
+// The largest message is a full effect rule set.
+#define WEBSOCKET_MAX_MESSAGE EFFECT_RULES_MAX_MESSAGE
+static char message[WEBSOCKET_MAX_MESSAGE];
+
+// Complete messages are handed from the client task to websocket_init, which runs pinned
+// to the protocol core and does the JSON parsing. Room for a full rule set plus a
+// backlog of small event messages.
+#define WEBSOCKET_QUEUE_SIZE (2 * WEBSOCKET_MAX_MESSAGE)
+static MessageBufferHandle_t messageQueue = NULL;
+
+static void websocket_handle_message(const char *json, size_t len)
+{
+    cJSON *root = cJSON_ParseWithLength(json, len);
+    if (!root)
+    {
+        ESP_LOGE(TAG, "Failed to parse JSON");
+        stats.errors++;
+        return;
+    }
+
+    stats.messages++;
+    cJSON *type = cJSON_GetObjectItem(root, "type");
+    cJSON *segment = cJSON_GetObjectItem(root, "segment");
+    cJSON *value = cJSON_GetObjectItem(root, "value");
+    if (cJSON_IsString(type) && strcmp(type->valuestring, "rules") == 0)
+    {
+        effect_rules_apply_json(root);
+    }
+    else if (cJSON_IsString(type) && segment)
+    {
+        ESP_LOGW(TAG, "Type: %s, Segment: %d, Value: %lld",
+                 type->valuestring, segment->valueint,
+                 value ? (int64_t)value->valuedouble : 0);
+
+        // The hub sends 7 for events not tied to a segment. Anything outside the segment
+        // range becomes 0 before it is narrowed, so e.g. 257 cannot wrap onto segment 1.
+        bool inRange = cJSON_IsNumber(segment) && segment->valueint >= 1 && segment->valueint <= LIGHTS_SEGMENT_COUNT;
+
+        // Resolve the type here so the render task never touches strings
+        blink_event_t event = {
+            .type = lights_event_type_from_string(type->valuestring),
+            .segment = inRange ? segment->valueint : 0,
+            .value = value ? (int64_t)value->valuedouble : 0,
+        };
+        if (event.type != LIGHTS_EVENT_UNKNOWN && !queue_lights_event(&event))
+        {
+            ESP_LOGW(TAG, "Lights queue full, dropped %s", type->valuestring);
+        }
+    }
+    cJSON_Delete(root);
+}
+
+// Runs in the client task, leaves the parsing to websocket_init
+static void websocket_queue_message(const char *data, size_t len)
+{
+    if (xMessageBufferSend(messageQueue, data, len, 0) != len)
+    {
+        ESP_LOGW(TAG, "Message queue full, dropped %d bytes", (int)len);
+        stats.errors++;
+    }
+}
+
+// Tell the hub which rule set we have so it can push a newer one
+static void websocket_send_hello(esp_websocket_client_handle_t client)
+{
+    char hello[64];
+    int len = snprintf(hello, sizeof(hello), "{\"type\":\"hello\",\"rules_version\":%lu}",
+                       (unsigned long)effect_rules_version());
+    esp_websocket_client_send_text(client, hello, len, pdMS_TO_TICKS(1000));
+}
+
 static void websocket_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
     esp_websocket_event_data_t *data = (esp_websocket_event_data_t *)event_data;
@@ -18,45 +96,49 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base, i
     {
     case WEBSOCKET_EVENT_CONNECTED:
         ESP_LOGI(TAG, "WEBSOCKET_EVENT_CONNECTED");
+        stats.connected = true;
+        stats.connects++;
+        websocket_send_hello((esp_websocket_client_handle_t)handler_args);
         break;
     case WEBSOCKET_EVENT_DISCONNECTED:
         ESP_LOGI(TAG, "WEBSOCKET_EVENT_DISCONNECTED");
+        stats.connected = false;
+        stats.disconnects++;
         break;
     case WEBSOCKET_EVENT_DATA:
         if (data->op_code == 0x01 || data->op_code == 0x02) // Text or Binary frame
         {
-            cJSON *root = cJSON_Parse(data->data_ptr);
-            if (root)
+            if (data->payload_len == data->data_len)
+            {
+                websocket_queue_message(data->data_ptr, data->data_len);
+            }
+            else if (data->payload_len <= WEBSOCKET_MAX_MESSAGE &&
+                     data->payload_offset + data->data_len <= data->payload_len)
             {
-                blink_event_t event = {0};
-                cJSON *type = cJSON_GetObjectItem(root, "type");
-                cJSON *segment = cJSON_GetObjectItem(root, "segment");
-                cJSON *value = cJSON_GetObjectItem(root, "value");
-                if (type && segment)
+                memcpy(message + data->payload_offset, data->data_ptr, data->data_len);
+                if (data->payload_offset + data->data_len == data->payload_len)
                 {
-                    ESP_LOGW(TAG, "Type: %s, Segment: %d, Value: %lld",
-                             type->valuestring, segment->valueint,
-                             value ? (int64_t)value->valuedouble : 0);
-
-                    strncpy(event.type, type->valuestring, sizeof(event.type) - 1);
-                    event.segment = segment->valueint;
-                    event.value = value ? (int64_t)value->valuedouble : 0;
-                    queue_lights_event(event);
+                    websocket_queue_message(message, data->payload_len);
                 }
-                cJSON_Delete(root);
             }
             else
             {
-                ESP_LOGE(TAG, "Failed to parse JSON");
+                ESP_LOGE(TAG, "Message too large: %d bytes", data->payload_len);
             }
         }
         break;
     case WEBSOCKET_EVENT_ERROR:
         ESP_LOGI(TAG, "WEBSOCKET_EVENT_ERROR");
+        stats.errors++;
         break;
     }
 }
 
+void websocket_get_stats(websocket_stats_t *out)
+{
+    *out = stats;
+}
+
 // {Segment:4 Type:mining.notify Value:}
 void websocket_init(void *pvParameters)
 {
@@ -81,17 +163,30 @@ void websocket_init(void *pvParameters)
         .skip_cert_common_name_check = true,
         .ping_interval_sec = 1,
         .disable_pingpong_discon = true,
-        .use_global_ca_store = true
+        .use_global_ca_store = true,
+        .task_prio = WEBSOCKET_TASK_PRIORITY,
     };
 
+    messageQueue = xMessageBufferCreate(WEBSOCKET_QUEUE_SIZE);
+    if (messageQueue == NULL) {
+        ESP_LOGE(TAG, "Failed to create message queue");
+        vTaskDelete(NULL);
+        return;
+    }
+
     esp_websocket_client_handle_t client = esp_websocket_client_init(&ws_config);
     esp_websocket_register_events(client, WEBSOCKET_EVENT_ANY, websocket_event_handler, (void *)client);
     esp_websocket_client_start(client);
-    vTaskDelay(4000 / portTICK_PERIOD_MS);
 
+    // Parse here, on the protocol core, and feed the render task's event ring
+    static char received[WEBSOCKET_MAX_MESSAGE];
     while (1)
     {
-        vTaskDelay(30000 / portTICK_PERIOD_MS);
+        size_t len = xMessageBufferReceive(messageQueue, received, sizeof(received), portMAX_DELAY);
+        if (len > 0)
+        {
+            websocket_handle_message(received, len);
+        }
     }
 
     // Note: This code will never be reached unless the while loop is broken
@@ -1,6 +1,24 @@
 #ifndef WEBSOCKET_H
 #define WEBSOCKET_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+// The websocket client task is not pinned. Its handler only queues complete messages;
+// websocket_init parses them pinned to the protocol core, below the render task priority.
+#define WEBSOCKET_TASK_PRIORITY 5
+#define WEBSOCKET_TASK_CORE 0
+
+typedef struct
+{
+    bool connected;
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t messages;
+    uint32_t errors; // Websocket errors and unparsable messages
+} websocket_stats_t;
+
 void websocket_init(void *pvParameters);
+void websocket_get_stats(websocket_stats_t *stats);
 
 #endif // WEBSOCKET_H
\ No newline at end of file
@@ -6,10 +6,15 @@
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "config_manager.h"
+#include "config_portal.h"
+#include "esp_netif_sntp.h"
 #include <string.h>
 
 static const char *TAG = "WIFI_MANAGER";
 
+static bool sntp_started = false;
+static bool websocket_started = false;
+
 static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
@@ -24,8 +29,25 @@ static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_
     {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
         ESP_LOGI(TAG, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
-        ESP_LOGI(TAG, "Initializing Go websocket");
-        xTaskCreate(&websocket_init, "websocket_init", 8192, NULL, 5, NULL);
+        // Clock for the lights brightness schedule
+        if (!sntp_started)
+        {
+            esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG("pool.ntp.org");
+            esp_netif_sntp_init(&sntp_config);
+            sntp_started = true;
+        }
+
+        // Configuration, status and OTA stay reachable on the station network
+        config_portal_start();
+
+        // The websocket client reconnects by itself after WiFi comes back
+        if (!websocket_started)
+        {
+            ESP_LOGI(TAG, "Initializing Go websocket");
+            xTaskCreatePinnedToCore(&websocket_init, "websocket_init", 8192, NULL,
+                                    WEBSOCKET_TASK_PRIORITY, NULL, WEBSOCKET_TASK_CORE);
+            websocket_started = true;
+        }
     }
 }
 